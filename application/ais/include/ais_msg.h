@@ -0,0 +1,174 @@
+#ifndef APPLICATION_LIB_INCLUDE_AIS_MSG_H
+#define APPLICATION_LIB_INCLUDE_AIS_MSG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Decoded AIS messages. Values are kept in the units used on the air:
+ * positions in 1/10000 minutes, speed in 1/10 knots, course in 1/10
+ * degrees, dimensions in meters.
+ */
+
+#define AIS_LON_NOT_AVAILABLE (181 * 600000)
+#define AIS_LAT_NOT_AVAILABLE (91 * 600000)
+#define AIS_SPEED_NOT_AVAILABLE 1023
+#define AIS_COURSE_NOT_AVAILABLE 3600
+#define AIS_HEADING_NOT_AVAILABLE 511
+
+/**
+ * The parser loads 32 bits at a time, the buffer must stay readable for
+ * this many bytes past the end of the message.
+ */
+#define AIS_MSG_BUFFER_PADDING 4
+
+struct ais_dimensions {
+	uint16_t to_bow;
+	uint16_t to_stern;
+	uint8_t to_port;
+	uint8_t to_starboard;
+};
+
+/** Common part of position reports (types 1, 2, 3, 18 and 19). */
+struct ais_position {
+	int32_t lon;
+	int32_t lat;
+	uint16_t speed;
+	uint16_t course;
+	uint16_t heading;
+	uint8_t second;
+	uint8_t accuracy;
+	uint8_t raim;
+	uint32_t radio;
+};
+
+/** Types 1, 2 and 3. */
+struct ais_msg_class_a {
+	struct ais_position pos;
+	uint8_t status;
+	int8_t turn;
+	uint8_t maneuver;
+};
+
+/** Types 4 and 11. */
+struct ais_msg_base_station {
+	uint16_t year;
+	uint8_t month;
+	uint8_t day;
+	uint8_t hour;
+	uint8_t minute;
+	uint8_t second;
+	uint8_t accuracy;
+	int32_t lon;
+	int32_t lat;
+	uint8_t epfd;
+	uint8_t raim;
+	uint32_t radio;
+};
+
+/** Type 5. */
+struct ais_msg_static_voyage {
+	uint32_t imo;
+	char callsign[8];
+	char shipname[21];
+	uint8_t ais_version;
+	uint8_t shiptype;
+	struct ais_dimensions dim;
+	uint8_t epfd;
+	uint8_t month;
+	uint8_t day;
+	uint8_t hour;
+	uint8_t minute;
+	/** Draught in 1/10 meters. */
+	uint8_t draught;
+	char destination[21];
+	uint8_t dte;
+};
+
+/** Type 18. */
+struct ais_msg_class_b {
+	struct ais_position pos;
+	uint8_t cs;
+	uint8_t display;
+	uint8_t dsc;
+	uint8_t band;
+	uint8_t msg22;
+	uint8_t assigned;
+};
+
+/** Type 19. */
+struct ais_msg_class_b_ext {
+	struct ais_position pos;
+	char shipname[21];
+	uint8_t shiptype;
+	struct ais_dimensions dim;
+	uint8_t epfd;
+	uint8_t dte;
+	uint8_t assigned;
+};
+
+/** Type 21. */
+struct ais_msg_aton {
+	int32_t lon;
+	int32_t lat;
+	char name[21];
+	uint8_t aid_type;
+	uint8_t accuracy;
+	struct ais_dimensions dim;
+	uint8_t epfd;
+	uint8_t second;
+	uint8_t off_position;
+	uint8_t raim;
+	uint8_t virtual_aid;
+	uint8_t assigned;
+};
+
+/** Type 24, part A carries shipname only, part B the rest. */
+struct ais_msg_static_data {
+	uint8_t partno;
+	char shipname[21];
+	uint8_t shiptype;
+	char vendorid[4];
+	uint8_t model;
+	uint32_t serial;
+	char callsign[8];
+	/** Valid for regular vessels. */
+	struct ais_dimensions dim;
+	/** Valid for auxiliary craft, shares bits with dim. */
+	uint32_t mothership_mmsi;
+};
+
+struct ais_msg {
+	uint8_t type;
+	uint8_t repeat;
+	uint32_t mmsi;
+	union {
+		struct ais_msg_class_a class_a;
+		struct ais_msg_base_station base_station;
+		struct ais_msg_static_voyage static_voyage;
+		struct ais_msg_class_b class_b;
+		struct ais_msg_class_b_ext class_b_ext;
+		struct ais_msg_aton aton;
+		struct ais_msg_static_data static_data;
+	};
+};
+
+/**
+ * Parse a message payload.
+ *
+ * Fields that do not fit into a short message are left zero.
+ *
+ * @param buf Payload as reported by the HDLC decoder, see
+ *            AIS_MSG_BUFFER_PADDING.
+ * @param len Payload length in bytes.
+ * @param msg Parsed message.
+ *
+ * @return 0 on success, -ENOTSUP for unsupported message types, -EINVAL if
+ *         the message is too short.
+ */
+int ais_msg_parse(const uint8_t *buf, size_t len, struct ais_msg *msg);
+
+/** Position part of a parsed message or NULL if there is none. */
+const struct ais_position *ais_msg_position(const struct ais_msg *msg);
+
+#endif
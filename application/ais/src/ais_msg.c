@@ -0,0 +1,311 @@
+#include "ais_msg.h"
+#include <errno.h>
+#include <string.h>
+#include <toolchain.h>
+#include <sys/util.h>
+#include <sys/byteorder.h>
+
+enum ais_field_kind {
+	AIS_FIELD_U8,
+	AIS_FIELD_U16,
+	AIS_FIELD_U32,
+	AIS_FIELD_I8,
+	AIS_FIELD_I32,
+	/** Six bit text, width is the number of characters. */
+	AIS_FIELD_STR,
+};
+
+struct ais_field {
+	uint16_t start;
+	uint8_t width;
+	uint8_t kind;
+	uint16_t offset;
+};
+
+struct ais_msg_desc {
+	uint16_t min_bits;
+	uint8_t num_fields;
+	const struct ais_field *fields;
+};
+
+#define FIELD(kind, start, width, member) \
+	{ start, width, AIS_FIELD_##kind, offsetof(struct ais_msg, member) }
+
+#define DESC(min_bits, fields) { min_bits, ARRAY_SIZE(fields), fields }
+
+#define POSITION_FIELDS(m, speed_bit)				\
+	FIELD(U16, speed_bit, 10, m.speed),			\
+	FIELD(U8, speed_bit + 10, 1, m.accuracy),		\
+	FIELD(I32, speed_bit + 11, 28, m.lon),			\
+	FIELD(I32, speed_bit + 39, 27, m.lat),			\
+	FIELD(U16, speed_bit + 66, 12, m.course),		\
+	FIELD(U16, speed_bit + 78, 9, m.heading),		\
+	FIELD(U8, speed_bit + 87, 6, m.second)
+
+#define DIMENSION_FIELDS(m, bow_bit)				\
+	FIELD(U16, bow_bit, 9, m.to_bow),			\
+	FIELD(U16, bow_bit + 9, 9, m.to_stern),			\
+	FIELD(U8, bow_bit + 18, 6, m.to_port),			\
+	FIELD(U8, bow_bit + 24, 6, m.to_starboard)
+
+static const struct ais_field class_a_fields[] = {
+	FIELD(U8, 38, 4, class_a.status),
+	FIELD(I8, 42, 8, class_a.turn),
+	POSITION_FIELDS(class_a.pos, 50),
+	FIELD(U8, 143, 2, class_a.maneuver),
+	FIELD(U8, 148, 1, class_a.pos.raim),
+	FIELD(U32, 149, 19, class_a.pos.radio),
+};
+
+static const struct ais_field base_station_fields[] = {
+	FIELD(U16, 38, 14, base_station.year),
+	FIELD(U8, 52, 4, base_station.month),
+	FIELD(U8, 56, 5, base_station.day),
+	FIELD(U8, 61, 5, base_station.hour),
+	FIELD(U8, 66, 6, base_station.minute),
+	FIELD(U8, 72, 6, base_station.second),
+	FIELD(U8, 78, 1, base_station.accuracy),
+	FIELD(I32, 79, 28, base_station.lon),
+	FIELD(I32, 107, 27, base_station.lat),
+	FIELD(U8, 134, 4, base_station.epfd),
+	FIELD(U8, 148, 1, base_station.raim),
+	FIELD(U32, 149, 19, base_station.radio),
+};
+
+static const struct ais_field static_voyage_fields[] = {
+	FIELD(U8, 38, 2, static_voyage.ais_version),
+	FIELD(U32, 40, 30, static_voyage.imo),
+	FIELD(STR, 70, 7, static_voyage.callsign),
+	FIELD(STR, 112, 20, static_voyage.shipname),
+	FIELD(U8, 232, 8, static_voyage.shiptype),
+	DIMENSION_FIELDS(static_voyage.dim, 240),
+	FIELD(U8, 270, 4, static_voyage.epfd),
+	FIELD(U8, 274, 4, static_voyage.month),
+	FIELD(U8, 278, 5, static_voyage.day),
+	FIELD(U8, 283, 5, static_voyage.hour),
+	FIELD(U8, 288, 6, static_voyage.minute),
+	FIELD(U8, 294, 8, static_voyage.draught),
+	FIELD(STR, 302, 20, static_voyage.destination),
+	FIELD(U8, 422, 1, static_voyage.dte),
+};
+
+static const struct ais_field class_b_fields[] = {
+	POSITION_FIELDS(class_b.pos, 46),
+	FIELD(U8, 141, 1, class_b.cs),
+	FIELD(U8, 142, 1, class_b.display),
+	FIELD(U8, 143, 1, class_b.dsc),
+	FIELD(U8, 144, 1, class_b.band),
+	FIELD(U8, 145, 1, class_b.msg22),
+	FIELD(U8, 146, 1, class_b.assigned),
+	FIELD(U8, 147, 1, class_b.pos.raim),
+	FIELD(U32, 148, 20, class_b.pos.radio),
+};
+
+static const struct ais_field class_b_ext_fields[] = {
+	POSITION_FIELDS(class_b_ext.pos, 46),
+	FIELD(STR, 143, 20, class_b_ext.shipname),
+	FIELD(U8, 263, 8, class_b_ext.shiptype),
+	DIMENSION_FIELDS(class_b_ext.dim, 271),
+	FIELD(U8, 301, 4, class_b_ext.epfd),
+	FIELD(U8, 305, 1, class_b_ext.pos.raim),
+	FIELD(U8, 306, 1, class_b_ext.dte),
+	FIELD(U8, 307, 1, class_b_ext.assigned),
+};
+
+static const struct ais_field aton_fields[] = {
+	FIELD(U8, 38, 5, aton.aid_type),
+	FIELD(STR, 43, 20, aton.name),
+	FIELD(U8, 163, 1, aton.accuracy),
+	FIELD(I32, 164, 28, aton.lon),
+	FIELD(I32, 192, 27, aton.lat),
+	DIMENSION_FIELDS(aton.dim, 219),
+	FIELD(U8, 249, 4, aton.epfd),
+	FIELD(U8, 253, 6, aton.second),
+	FIELD(U8, 259, 1, aton.off_position),
+	FIELD(U8, 268, 1, aton.raim),
+	FIELD(U8, 269, 1, aton.virtual_aid),
+	FIELD(U8, 270, 1, aton.assigned),
+};
+
+static const struct ais_field static_data_a_fields[] = {
+	FIELD(U8, 38, 2, static_data.partno),
+	FIELD(STR, 40, 20, static_data.shipname),
+};
+
+static const struct ais_field static_data_b_fields[] = {
+	FIELD(U8, 38, 2, static_data.partno),
+	FIELD(U8, 40, 8, static_data.shiptype),
+	FIELD(STR, 48, 3, static_data.vendorid),
+	FIELD(U8, 66, 4, static_data.model),
+	FIELD(U32, 70, 20, static_data.serial),
+	FIELD(STR, 90, 7, static_data.callsign),
+	DIMENSION_FIELDS(static_data.dim, 132),
+	FIELD(U32, 132, 30, static_data.mothership_mmsi),
+};
+
+static const struct ais_msg_desc descs[] = {
+	[1] = DESC(168, class_a_fields),
+	[2] = DESC(168, class_a_fields),
+	[3] = DESC(168, class_a_fields),
+	[4] = DESC(168, base_station_fields),
+	[5] = DESC(420, static_voyage_fields),
+	[11] = DESC(168, base_station_fields),
+	[18] = DESC(168, class_b_fields),
+	[19] = DESC(312, class_b_ext_fields),
+	[21] = DESC(272, aton_fields),
+};
+
+static const struct ais_msg_desc static_data_descs[] = {
+	DESC(160, static_data_a_fields),
+	DESC(168, static_data_b_fields),
+};
+
+/* Load 32 bits starting at a bit offset, MSB aligned. */
+static inline uint32_t load_bits(const uint8_t *buf, uint16_t start)
+{
+	const uint8_t *p = buf + start / 8;
+	uint8_t shift = start % 8;
+	uint32_t w = sys_be32_to_cpu(UNALIGNED_GET((const uint32_t *)p));
+
+	if (shift != 0) {
+		w = (w << shift) | (p[4] >> (8 - shift));
+	}
+
+	return w;
+}
+
+static inline uint32_t get_bits(const uint8_t *buf, uint16_t start,
+				uint8_t width)
+{
+	return load_bits(buf, start) >> (32 - width);
+}
+
+static inline int32_t get_sbits(const uint8_t *buf, uint16_t start,
+				uint8_t width)
+{
+	return (int32_t)load_bits(buf, start) >> (32 - width);
+}
+
+static inline char ascii6(uint8_t v)
+{
+	return v < 32 ? v + 64 : v;
+}
+
+static void get_string(const uint8_t *buf, uint16_t start, uint8_t chars,
+		       char *out)
+{
+	char *p = out;
+
+	/* Four characters per load. */
+	for (uint8_t i = 0; i < chars; i += 4) {
+		uint32_t w = load_bits(buf, start + i * 6);
+		uint8_t n = MIN(4, chars - i);
+
+		for (uint8_t j = 0; j < n; j++) {
+			*p++ = ascii6(w >> 26);
+			w <<= 6;
+		}
+	}
+
+	/* Strip '@' padding and trailing spaces. */
+	while (p > out && (p[-1] == '@' || p[-1] == ' ')) {
+		p--;
+	}
+
+	*p = '\0';
+}
+
+static void parse_fields(const uint8_t *buf, size_t num_bits,
+			 const struct ais_msg_desc *desc, struct ais_msg *msg)
+{
+	uint8_t *base = (uint8_t *)msg;
+
+	for (uint8_t i = 0; i < desc->num_fields; i++) {
+		const struct ais_field *f = &desc->fields[i];
+		void *dst = base + f->offset;
+		uint16_t bits = f->kind == AIS_FIELD_STR ?
+			f->width * 6 : f->width;
+
+		if (f->start + bits > num_bits) {
+			continue;
+		}
+
+		switch (f->kind) {
+		case AIS_FIELD_U8:
+			*(uint8_t *)dst = get_bits(buf, f->start, f->width);
+			break;
+		case AIS_FIELD_U16:
+			*(uint16_t *)dst = get_bits(buf, f->start, f->width);
+			break;
+		case AIS_FIELD_U32:
+			*(uint32_t *)dst = get_bits(buf, f->start, f->width);
+			break;
+		case AIS_FIELD_I8:
+			*(int8_t *)dst = get_sbits(buf, f->start, f->width);
+			break;
+		case AIS_FIELD_I32:
+			*(int32_t *)dst = get_sbits(buf, f->start, f->width);
+			break;
+		case AIS_FIELD_STR:
+			get_string(buf, f->start, f->width, dst);
+			break;
+		}
+	}
+}
+
+int ais_msg_parse(const uint8_t *buf, size_t len, struct ais_msg *msg)
+{
+	size_t num_bits = len * 8;
+	const struct ais_msg_desc *desc;
+
+	if (num_bits < 38) {
+		return -EINVAL;
+	}
+
+	memset(msg, 0, sizeof(*msg));
+	msg->type = get_bits(buf, 0, 6);
+	msg->repeat = get_bits(buf, 6, 2);
+	msg->mmsi = get_bits(buf, 8, 30);
+
+	if (msg->type == 24) {
+		if (num_bits < 40) {
+			return -EINVAL;
+		}
+
+		uint8_t partno = get_bits(buf, 38, 2);
+		if (partno >= ARRAY_SIZE(static_data_descs)) {
+			return -ENOTSUP;
+		}
+
+		desc = &static_data_descs[partno];
+	} else if (msg->type < ARRAY_SIZE(descs) &&
+		   descs[msg->type].fields != NULL) {
+		desc = &descs[msg->type];
+	} else {
+		return -ENOTSUP;
+	}
+
+	if (num_bits < desc->min_bits) {
+		return -EINVAL;
+	}
+
+	parse_fields(buf, num_bits, desc, msg);
+
+	return 0;
+}
+
+const struct ais_position *ais_msg_position(const struct ais_msg *msg)
+{
+	switch (msg->type) {
+	case 1:
+	case 2:
+	case 3:
+		return &msg->class_a.pos;
+	case 18:
+		return &msg->class_b.pos;
+	case 19:
+		return &msg->class_b_ext.pos;
+	default:
+		return NULL;
+	}
+}
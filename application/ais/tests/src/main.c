@@ -0,0 +1,236 @@
+#include <ztest.h>
+#include <string.h>
+#include <ais_msg.h>
+
+#define BENCH_ITERATIONS 100
+
+static uint8_t payload[128 + AIS_MSG_BUFFER_PADDING];
+
+/* Convert an armored !AIVDM payload into bytes. */
+static size_t dearmor(const char *s, unsigned int pad)
+{
+	size_t num_bits = 0;
+
+	memset(payload, 0, sizeof(payload));
+
+	for (; *s; s++) {
+		uint8_t v = *s - 48;
+
+		if (v > 40) {
+			v -= 8;
+		}
+
+		for (int i = 5; i >= 0; i--) {
+			if (v & BIT(i)) {
+				payload[num_bits / 8] |= 0x80 >> (num_bits % 8);
+			}
+			num_bits++;
+		}
+	}
+
+	return (num_bits - pad) / 8;
+}
+
+static void parse(const char *s, unsigned int pad, struct ais_msg *msg)
+{
+	size_t len = dearmor(s, pad);
+
+	zassert_equal(ais_msg_parse(payload, len, msg), 0, NULL);
+}
+
+static void test_class_a(void)
+{
+	struct ais_msg msg;
+
+	parse("177KQJ5000G?tO`K>RA1wUbN0TKH", 0, &msg);
+
+	zassert_equal(msg.type, 1, NULL);
+	zassert_equal(msg.mmsi, 477553000, NULL);
+	zassert_equal(msg.class_a.status, 5, NULL);
+	zassert_equal(msg.class_a.turn, 0, NULL);
+	zassert_equal(msg.class_a.pos.speed, 0, NULL);
+	zassert_equal(msg.class_a.pos.lon, -73407500, NULL);
+	zassert_equal(msg.class_a.pos.lat, 28549700, NULL);
+	zassert_equal(msg.class_a.pos.course, 510, NULL);
+	zassert_equal(msg.class_a.pos.heading, 181, NULL);
+	zassert_equal(msg.class_a.pos.second, 15, NULL);
+	zassert_equal(ais_msg_position(&msg), &msg.class_a.pos, NULL);
+}
+
+static void test_base_station(void)
+{
+	struct ais_msg msg;
+
+	parse("403OviQuMGCqWrRO9>E6fE700@GO", 0, &msg);
+
+	zassert_equal(msg.type, 4, NULL);
+	zassert_equal(msg.mmsi, 3669702, NULL);
+	zassert_equal(msg.base_station.year, 2007, NULL);
+	zassert_equal(msg.base_station.month, 5, NULL);
+	zassert_equal(msg.base_station.day, 14, NULL);
+	zassert_equal(msg.base_station.hour, 19, NULL);
+	zassert_equal(msg.base_station.minute, 57, NULL);
+	zassert_equal(msg.base_station.second, 39, NULL);
+	zassert_equal(msg.base_station.accuracy, 1, NULL);
+	zassert_equal(msg.base_station.epfd, 7, NULL);
+	zassert_is_null(ais_msg_position(&msg), NULL);
+}
+
+static void test_static_voyage(void)
+{
+	struct ais_msg msg;
+
+	parse("55?MbV02;H;s<HtKR20EHE:0@T4@Dn2222222216L961O5Gf0NSQEp6ClRp8"
+	      "88888888880", 2, &msg);
+
+	zassert_equal(msg.type, 5, NULL);
+	zassert_equal(msg.mmsi, 351759000, NULL);
+	zassert_equal(msg.static_voyage.imo, 9134270, NULL);
+	zassert_equal(strcmp(msg.static_voyage.callsign, "3FOF8"), 0, NULL);
+	zassert_equal(strcmp(msg.static_voyage.shipname, "EVER DIADEM"), 0,
+		      NULL);
+	zassert_equal(msg.static_voyage.shiptype, 70, NULL);
+	zassert_equal(msg.static_voyage.dim.to_bow, 225, NULL);
+	zassert_equal(msg.static_voyage.dim.to_stern, 70, NULL);
+	zassert_equal(msg.static_voyage.dim.to_port, 1, NULL);
+	zassert_equal(msg.static_voyage.dim.to_starboard, 31, NULL);
+	zassert_equal(msg.static_voyage.month, 5, NULL);
+	zassert_equal(msg.static_voyage.day, 15, NULL);
+	zassert_equal(msg.static_voyage.hour, 14, NULL);
+	zassert_equal(msg.static_voyage.draught, 122, NULL);
+	zassert_equal(strcmp(msg.static_voyage.destination, "NEW YORK"), 0,
+		      NULL);
+}
+
+static void test_class_b(void)
+{
+	struct ais_msg msg;
+
+	parse("B52K>;h00Fc>jpUlNV@ikwpUoP06", 0, &msg);
+
+	zassert_equal(msg.type, 18, NULL);
+	zassert_equal(msg.mmsi, 338087471, NULL);
+	zassert_equal(msg.class_b.pos.speed, 1, NULL);
+	zassert_equal(msg.class_b.pos.lon, -44443279, NULL);
+	zassert_equal(msg.class_b.pos.lat, 24410724, NULL);
+	zassert_equal(msg.class_b.pos.course, 796, NULL);
+	zassert_equal(msg.class_b.pos.heading, AIS_HEADING_NOT_AVAILABLE,
+		      NULL);
+	zassert_equal(msg.class_b.pos.second, 49, NULL);
+}
+
+static void test_class_b_ext(void)
+{
+	struct ais_msg msg;
+
+	parse("C5N3SRgPEnJGEBT>NhWAwwo862PaLELTBJ:V00000000S0D:R220", 0, &msg);
+
+	zassert_equal(msg.type, 19, NULL);
+	zassert_equal(msg.mmsi, 367059850, NULL);
+	zassert_equal(msg.class_b_ext.pos.speed, 87, NULL);
+	zassert_equal(msg.class_b_ext.pos.course, 3359, NULL);
+	zassert_equal(msg.class_b_ext.pos.second, 46, NULL);
+	zassert_equal(strcmp(msg.class_b_ext.shipname, "CAPT.J.RIMES"), 0,
+		      NULL);
+	zassert_equal(msg.class_b_ext.shiptype, 70, NULL);
+	zassert_equal(msg.class_b_ext.dim.to_bow, 5, NULL);
+	zassert_equal(msg.class_b_ext.dim.to_stern, 21, NULL);
+	zassert_equal(msg.class_b_ext.epfd, 1, NULL);
+}
+
+static void test_aton(void)
+{
+	struct ais_msg msg;
+
+	parse("E>jHD0aW7a:4@84Ra0000000000OvnhP>fwT050`@@v000", 0, &msg);
+
+	zassert_equal(msg.type, 21, NULL);
+	zassert_equal(msg.mmsi, 992351234, NULL);
+	zassert_equal(msg.aton.aid_type, 19, NULL);
+	zassert_equal(strcmp(msg.aton.name, "NORTH PIER"), 0, NULL);
+	zassert_equal(msg.aton.lon, -300000, NULL);
+	zassert_equal(msg.aton.lat, 30900000, NULL);
+	zassert_equal(msg.aton.dim.to_bow, 5, NULL);
+	zassert_equal(msg.aton.dim.to_starboard, 2, NULL);
+	zassert_equal(msg.aton.second, 60, NULL);
+}
+
+static void test_static_data(void)
+{
+	struct ais_msg msg;
+
+	parse("H42O55i18tMET00000000000000", 2, &msg);
+
+	zassert_equal(msg.type, 24, NULL);
+	zassert_equal(msg.mmsi, 271041815, NULL);
+	zassert_equal(msg.static_data.partno, 0, NULL);
+	zassert_equal(strcmp(msg.static_data.shipname, "PROGUY"), 0, NULL);
+
+	parse("H42O55lti4hhhilD3nink000?050", 0, &msg);
+
+	zassert_equal(msg.static_data.partno, 1, NULL);
+	zassert_equal(msg.static_data.shiptype, 60, NULL);
+	zassert_equal(strcmp(msg.static_data.vendorid, "1D0"), 0, NULL);
+	zassert_equal(strcmp(msg.static_data.callsign, "TC6163"), 0, NULL);
+	zassert_equal(msg.static_data.dim.to_stern, 15, NULL);
+	zassert_equal(msg.static_data.dim.to_starboard, 5, NULL);
+}
+
+static void test_errors(void)
+{
+	struct ais_msg msg;
+	size_t len = dearmor("177KQJ5000G?tO`K>RA1wUbN0TKH", 0);
+
+	zassert_equal(ais_msg_parse(payload, 4, &msg), -EINVAL, NULL);
+	zassert_equal(ais_msg_parse(payload, len - 1, &msg), -EINVAL, NULL);
+
+	/* Type 8, binary broadcast. */
+	payload[0] = 8 << 2;
+	zassert_equal(ais_msg_parse(payload, len, &msg), -ENOTSUP, NULL);
+}
+
+static void bench(const char *name, const char *s, unsigned int pad)
+{
+	struct ais_msg msg;
+	size_t len = dearmor(s, pad);
+	uint32_t start = k_cycle_get_32();
+
+	for (int i = 0; i < BENCH_ITERATIONS; i++) {
+		ais_msg_parse(payload, len, &msg);
+	}
+
+	uint32_t cycles = k_cycle_get_32() - start;
+
+	TC_PRINT("%-10s %u cycles\n", name, cycles / BENCH_ITERATIONS);
+}
+
+static void test_benchmark(void)
+{
+	bench("type 1", "177KQJ5000G?tO`K>RA1wUbN0TKH", 0);
+	bench("type 4", "403OviQuMGCqWrRO9>E6fE700@GO", 0);
+	bench("type 5", "55?MbV02;H;s<HtKR20EHE:0@T4@Dn2222222216L961O5Gf0"
+	      "NSQEp6ClRp888888888880", 2);
+	bench("type 18", "B52K>;h00Fc>jpUlNV@ikwpUoP06", 0);
+	bench("type 19", "C5N3SRgPEnJGEBT>NhWAwwo862PaLELTBJ:V00000000S0D:R220",
+	      0);
+	bench("type 21", "E>jHD0aW7a:4@84Ra0000000000OvnhP>fwT050`@@v000", 0);
+	bench("type 24A", "H42O55i18tMET00000000000000", 2);
+	bench("type 24B", "H42O55lti4hhhilD3nink000?050", 0);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(ais_msg_tests,
+		ztest_unit_test(test_class_a),
+		ztest_unit_test(test_base_station),
+		ztest_unit_test(test_static_voyage),
+		ztest_unit_test(test_class_b),
+		ztest_unit_test(test_class_b_ext),
+		ztest_unit_test(test_aton),
+		ztest_unit_test(test_static_data),
+		ztest_unit_test(test_errors),
+		ztest_unit_test(test_benchmark)
+	);
+
+	ztest_run_test_suite(ais_msg_tests);
+}
@@ -24,6 +24,14 @@ struct hdlc_data;
 
 typedef void (*hdlc_callback_t)(const struct hdlc_data *hdlc, const uint8_t *buf, size_t len);
 
+/**
+ * Called for packets that were preceded by a training sequence but failed
+ * the FCS check or were too long, for example due to a collision.
+ * num_bits is the number of bits received after the start flag, with stuffed
+ * bits removed.
+ */
+typedef void (*hdlc_error_callback_t)(const struct hdlc_data *hdlc, size_t num_bits);
+
 // FIXME use something sensible here
 #define HDLC_BUFFER_SIZE 128
 
@@ -31,12 +39,26 @@ struct hdlc_data {
 	enum hdlc_state state;
 	bool last_bit;
 	uint8_t num_ones;
+	/** The current packet was preceded by a training sequence. */
+	bool preamble;
 	uint16_t num_bits;
+	/**
+	 * Zeros stuffed by the transmitter into the current packet, including
+	 * its FCS. Valid during the callback.
+	 */
+	uint16_t num_stuffed;
+	/** FCS of the last valid packet, valid during the callback. */
+	uint16_t fcs;
 	hdlc_callback_t callback;
+	hdlc_error_callback_t error_callback;
+	/** Last decoded bits, most recent in bit 0. */
+	uint32_t history;
 	uint8_t buffer[HDLC_BUFFER_SIZE];
 };
 
 void hdlc_init(struct hdlc_data *hdlc, hdlc_callback_t callback);
+void hdlc_set_error_callback(struct hdlc_data *hdlc,
+			     hdlc_error_callback_t callback);
 void hdlc_input(struct hdlc_data *hdlc, bool raw_bit);
 
 #endif
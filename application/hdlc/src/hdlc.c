@@ -11,8 +11,33 @@ void hdlc_init(struct hdlc_data *hdlc, hdlc_callback_t callback)
 	hdlc->callback = callback;
 }
 
+void hdlc_set_error_callback(struct hdlc_data *hdlc,
+			     hdlc_error_callback_t callback)
+{
+	hdlc->error_callback = callback;
+}
+
 #define FCS_RESIDUE 0xf0b8
 
+/*
+ * The start flag is preceded by a 24 bit training sequence of alternating
+ * zeros and ones, check the last 16 bits of it.
+ */
+#define TRAINING_MASK 0xffff
+#define TRAINING_SHIFT 8
+/* Shortest AIS messages have 72 bits, plus FCS and part of the end flag. */
+#define MIN_ERROR_BITS (72 + 16 + 6)
+
+static void report_error(struct hdlc_data *hdlc)
+{
+	if (hdlc->preamble && hdlc->error_callback &&
+	    hdlc->num_bits >= MIN_ERROR_BITS) {
+		hdlc->error_callback(hdlc, hdlc->num_bits);
+	}
+
+	hdlc->preamble = false;
+}
+
 static void validate_packet(struct hdlc_data *hdlc)
 {
 	size_t num_bits = hdlc->num_bits;
@@ -24,6 +49,7 @@ static void validate_packet(struct hdlc_data *hdlc)
 	num_bits -= 16 + 6;
 
 	if ((num_bits % 8) != 0) {
+		report_error(hdlc);
 		return;
 	}
 
@@ -31,12 +57,16 @@ static void validate_packet(struct hdlc_data *hdlc)
 
 	uint16_t crc = crc16_ccitt(0xffff, hdlc->buffer, num_bytes + 2);
 	if (crc != FCS_RESIDUE) {
+		report_error(hdlc);
 		return;
 	}
 
 	LOG_DBG("bits: %u", num_bits);
 	LOG_HEXDUMP_DBG(hdlc->buffer, num_bytes, "packet:");
 
+	/* FCS is transmitted least significant byte first. */
+	hdlc->fcs = hdlc->buffer[num_bytes] | (hdlc->buffer[num_bytes + 1] << 8);
+
 	/* Pad the buffer with zeroes so it is easier to convert it to NMEA */
 	hdlc->buffer[num_bytes] = 0;
 
@@ -69,6 +99,12 @@ static inline void handle_final_zero(struct hdlc_data *hdlc, bool bit)
 	} else {
 		hdlc->state = HDLC_STATE_DATA;
 		hdlc->num_bits = 0;
+		hdlc->num_stuffed = 0;
+		uint32_t training = (hdlc->history >> TRAINING_SHIFT) &
+				    TRAINING_MASK;
+
+		hdlc->preamble = training == (0x5555 & TRAINING_MASK) ||
+				 training == (0xaaaa & TRAINING_MASK);
 	}
 }
 
@@ -78,8 +114,10 @@ static inline void handle_data(struct hdlc_data *hdlc, bool bit)
 
 	if (byte_idx >= ARRAY_SIZE(hdlc->buffer)) {
 		/* Message too large, reset the decoder. */
+		report_error(hdlc);
 		hdlc->num_ones = 0;
 		hdlc->state = HDLC_STATE_INITIAL_ZERO;
+		return;
 	}
 
 	uint8_t bit_offset = hdlc->num_bits % 8;
@@ -104,6 +142,7 @@ static inline void handle_skip_zero(struct hdlc_data *hdlc, bool bit)
 		hdlc->state = HDLC_STATE_PACKET_END;
 	} else {
 		hdlc->state = HDLC_STATE_DATA;
+		hdlc->num_stuffed++;
 	}
 }
 
@@ -117,6 +156,9 @@ static inline void handle_packet_end(struct hdlc_data *hdlc, bool bit)
 		validate_packet(hdlc);
 		hdlc->state = HDLC_STATE_DATA;
 		hdlc->num_bits = 0;
+		hdlc->num_stuffed = 0;
+		/* A packet directly following another one had no training. */
+		hdlc->preamble = false;
 	}
 }
 
@@ -132,6 +174,8 @@ void hdlc_input(struct hdlc_data *hdlc, bool raw_bit)
 	bool bit = raw_bit == hdlc->last_bit;
 	hdlc->last_bit = raw_bit;
 
+	hdlc->history = (hdlc->history << 1) | bit;
+
 	if (bit) {
 		hdlc->num_ones++;
 	} else {
@@ -1,21 +1,63 @@
 #include <ztest.h>
 #include <hdlc.h>
+#include <sys/crc.h>
 
 static const uint8_t bitstream[] = {
 #include <bitstream.inc>
 };
 
 static unsigned int packet_count;
+static unsigned int fcs_errors;
+static unsigned int error_count;
+static unsigned int stuffing_errors;
+
+/* Zeros a transmitter stuffs into the payload and FCS. */
+static unsigned int count_stuffed(const uint8_t *buf, size_t len,
+				  uint16_t fcs)
+{
+	unsigned int ones = 0;
+	unsigned int stuffed = 0;
+
+	for (size_t i = 0; i < (len + 2) * 8; i++) {
+		uint8_t byte = i < len * 8 ? buf[i / 8] :
+			       fcs >> (i - len * 8) / 8 * 8;
+
+		if (byte & BIT(i % 8)) {
+			if (++ones == 5) {
+				stuffed++;
+				ones = 0;
+			}
+		} else {
+			ones = 0;
+		}
+	}
+
+	return stuffed;
+}
 
 void test_callback(const struct hdlc_data *hdlc, const uint8_t *buf, size_t len)
 {
 	packet_count++;
+
+	if ((crc16_ccitt(0xffff, buf, len) ^ 0xffff) != hdlc->fcs) {
+		fcs_errors++;
+	}
+
+	if (count_stuffed(buf, len, hdlc->fcs) != hdlc->num_stuffed) {
+		stuffing_errors++;
+	}
+}
+
+void test_error_callback(const struct hdlc_data *hdlc, size_t num_bits)
+{
+	error_count++;
 }
 
 static void test_hdlc(void)
 {
 	struct hdlc_data hdlc;
 	hdlc_init(&hdlc, &test_callback);
+	hdlc_set_error_callback(&hdlc, &test_error_callback);
 
 	for (size_t i = 0; i < ARRAY_SIZE(bitstream); i++) {
 		uint8_t byte = bitstream[i];
@@ -27,6 +69,11 @@ static void test_hdlc(void)
 	}
 
 	zassert_equal(packet_count, 167, NULL);
+	zassert_equal(fcs_errors, 0, "reported FCS does not match payload");
+	zassert_equal(stuffing_errors, 0,
+		      "stuffed bits do not match payload");
+	/* Damaged packets with a training sequence in the recording. */
+	zassert_equal(error_count, 25, NULL);
 }
 
 void test_main(void)
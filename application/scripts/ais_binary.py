@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2020 Ievgenii Meshcheriakov
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""Reference decoder for the binary output format (CONFIG_APP_OUTPUT_BINARY).
+
+Records are COBS encoded and delimited by zero bytes, see src/ais_binary.h
+for the layout. Can be used as a module or run on a capture file or a tty:
+
+    ais_binary.py /dev/ttyACM0
+"""
+
+import argparse
+import struct
+import sys
+from collections import namedtuple
+
+HAS_QUALITY = 0x01
+
+Record = namedtuple('Record', 'channel flags num_bits time_us quality payload')
+
+
+class DecodeError(Exception):
+    pass
+
+
+def crc16_ccitt(data, seed=0xffff):
+    """Same as Zephyr crc16_ccitt()."""
+    crc = seed
+    for b in data:
+        e = (crc ^ b) & 0xff
+        f = (e ^ (e << 4)) & 0xff
+        crc = ((crc >> 8) ^ (f << 8) ^ (f << 3) ^ (f >> 4)) & 0xffff
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0:
+            raise DecodeError('zero byte inside COBS block')
+        end = i + code
+        if end > len(data):
+            raise DecodeError('truncated COBS block')
+        out += data[i + 1:end]
+        i = end
+        if code < 0xff and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def decode_record(frame):
+    """Decode one COBS frame (without the delimiter) into a Record."""
+    raw = cobs_decode(frame)
+    if len(raw) < 10:
+        raise DecodeError('record too short')
+
+    body, crc = raw[:-2], struct.unpack('<H', raw[-2:])[0]
+    if crc16_ccitt(body) != crc:
+        raise DecodeError('CRC mismatch')
+
+    channel, flags, num_bits, time_us = struct.unpack('<BBHI', body[:8])
+    pos = 8
+    quality = None
+    if flags & HAS_QUALITY:
+        quality = struct.unpack('<b', body[pos:pos + 1])[0]
+        pos += 1
+
+    payload = body[pos:]
+    if len(payload) != (num_bits + 7) // 8:
+        raise DecodeError('payload length does not match bit count')
+
+    return Record(channel, flags, num_bits, time_us, quality, payload)
+
+
+def decode_stream(stream):
+    """Yield records (or DecodeError instances) read from a binary stream."""
+    buf = bytearray()
+    while True:
+        chunk = stream.read(1)
+        if not chunk:
+            return
+        if chunk[0] != 0:
+            buf += chunk
+            continue
+        if buf:
+            try:
+                yield decode_record(bytes(buf))
+            except DecodeError as e:
+                yield e
+        buf.clear()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('input', help='capture file or tty device')
+    args = parser.parse_args()
+
+    with open(args.input, 'rb', buffering=0) as f:
+        for rec in decode_stream(f):
+            if isinstance(rec, DecodeError):
+                print('error: {}'.format(rec), file=sys.stderr)
+                continue
+            quality = '' if rec.quality is None else ' q={}'.format(rec.quality)
+            print('{:10d} {} {:4d}{} {}'.format(
+                rec.time_us, 'AB'[rec.channel & 1], rec.num_bits, quality,
+                rec.payload.hex()))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2020 Ievgenii Meshcheriakov
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""Split a raw capture stream (CONFIG_APP_CAPTURE) into per-channel files.
+
+Every output file has the same layout as
+hdlc/tests/src/gnuais-stereo-2rx-ch1-bitstream.bin: raw radio bits packed
+LSB first, so it can be fed directly to the HDLC tests.
+
+    capture_split.py /dev/ttyACM1 site
+    # produces site-ch1.bin and site-ch2.bin
+"""
+
+import argparse
+import struct
+import sys
+
+from ais_binary import DecodeError, cobs_decode, crc16_ccitt
+
+
+def decode_block(frame):
+    raw = cobs_decode(frame)
+    if len(raw) < 7:
+        raise DecodeError('block too short')
+
+    body, crc = raw[:-2], struct.unpack('<H', raw[-2:])[0]
+    if crc16_ccitt(body) != crc:
+        raise DecodeError('CRC mismatch')
+
+    channel, seq, num_bits = struct.unpack('<BHH', body[:5])
+    data = body[5:]
+    if len(data) != (num_bits + 7) // 8:
+        raise DecodeError('data length does not match bit count')
+    if num_bits % 8 != 0:
+        raise DecodeError('partial bytes are not supported')
+
+    return channel, seq, data
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('input', help='capture file or tty device')
+    parser.add_argument('prefix', help='output file name prefix')
+    args = parser.parse_args()
+
+    outputs = {}
+    last_seq = {}
+
+    with open(args.input, 'rb', buffering=0) as f:
+        buf = bytearray()
+        while True:
+            chunk = f.read(1)
+            if not chunk:
+                break
+            if chunk[0] != 0:
+                buf += chunk
+                continue
+            if not buf:
+                continue
+
+            try:
+                channel, seq, data = decode_block(bytes(buf))
+            except DecodeError as e:
+                print('error: {}'.format(e), file=sys.stderr)
+                buf.clear()
+                continue
+            buf.clear()
+
+            expected = (last_seq.get(channel, seq - 1) + 1) & 0xffff
+            if seq != expected:
+                print('ch{}: lost {} blocks'.format(
+                    channel + 1, (seq - expected) & 0xffff), file=sys.stderr)
+            last_seq[channel] = seq
+
+            if channel not in outputs:
+                name = '{}-ch{}.bin'.format(args.prefix, channel + 1)
+                outputs[channel] = open(name, 'wb')
+            outputs[channel].write(data)
+
+    for out in outputs.values():
+        out.close()
+
+
+if __name__ == '__main__':
+    main()
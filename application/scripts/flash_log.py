@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2020 Ievgenii Meshcheriakov
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""Decoder for the frame log dump (CONFIG_APP_FLASH_LOG).
+
+Reads the chunks sent to the log port by the "flog dump" shell command,
+see src/flash_log.h for the layout, and prints the frames oldest first:
+
+    flash_log.py /dev/ttyACM1
+"""
+
+import argparse
+import datetime
+import struct
+import sys
+from collections import namedtuple
+
+from ais_binary import DecodeError, cobs_decode, crc16_ccitt
+
+PAGE_SIZE = 2048
+PAGE_MAGIC = 0x474c4941
+PAGE_VERSION = 1
+PAGE_UTC = 0x01
+PAGE_HEADER = struct.Struct('<IIQHBBI')
+CHUNK_HEADER = struct.Struct('<IH')
+END_OFFSET = 0xffff
+
+RECORD_VALID = 0x80
+RECORD_AWAY = 0x04
+RECORD_QUALITY = 0x02
+RECORD_CHANNEL = 0x01
+
+Frame = namedtuple('Frame', 'time_ms utc channel away quality payload')
+
+
+def decode_chunk(frame):
+    """Decode one COBS chunk into (page sequence number, offset, data)."""
+    raw = cobs_decode(frame)
+    if len(raw) < CHUNK_HEADER.size + 2:
+        raise DecodeError('chunk too short')
+
+    body, crc = raw[:-2], struct.unpack('<H', raw[-2:])[0]
+    if crc16_ccitt(body) != crc:
+        raise DecodeError('CRC mismatch')
+
+    seq, offset = CHUNK_HEADER.unpack_from(body)
+    return seq, offset, body[CHUNK_HEADER.size:]
+
+
+def read_varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        if pos >= len(data):
+            raise DecodeError('truncated varint')
+        b = data[pos]
+        pos += 1
+        value |= (b & 0x7f) << shift
+        shift += 7
+        if b < 0x80:
+            break
+    return (value >> 1) ^ -(value & 1), pos
+
+
+def decode_page(page):
+    """Yield the frames stored in a page."""
+    magic, seq, base_ms, used, version, flags, _ = \
+        PAGE_HEADER.unpack_from(page)
+    if magic != PAGE_MAGIC or version != PAGE_VERSION:
+        raise DecodeError('bad page header')
+    if used > len(page):
+        raise DecodeError('page {} is incomplete'.format(seq))
+
+    utc = bool(flags & PAGE_UTC)
+    time_ms = base_ms
+    pos = PAGE_HEADER.size
+    while pos < used:
+        hdr, length = page[pos], page[pos + 1]
+        if not hdr & RECORD_VALID:
+            raise DecodeError('bad record header in page {}'.format(seq))
+        pos += 2
+        quality = None
+        if hdr & RECORD_QUALITY:
+            quality = struct.unpack_from('<b', page, pos)[0]
+            pos += 1
+        delta, pos = read_varint(page, pos)
+        time_ms += delta
+        yield Frame(time_ms, utc, hdr & RECORD_CHANNEL,
+                    bool(hdr & RECORD_AWAY), quality,
+                    bytes(page[pos:pos + length]))
+        pos += length
+
+
+def read_dump(stream):
+    """Collect the pages of a dump, in the order they were sent."""
+    pages = {}
+    buf = bytearray()
+    while True:
+        chunk = stream.read(1)
+        if not chunk:
+            break
+        if chunk[0] != 0:
+            buf += chunk
+            continue
+        if not buf:
+            continue
+
+        try:
+            seq, offset, data = decode_chunk(bytes(buf))
+        except DecodeError as e:
+            print('error: {}'.format(e), file=sys.stderr)
+            buf.clear()
+            continue
+        buf.clear()
+
+        if offset == END_OFFSET:
+            break
+        page = pages.setdefault(seq, bytearray())
+        if len(page) != offset:
+            print('page {}: chunk at {} lost'.format(seq, len(page)),
+                  file=sys.stderr)
+            page.extend(b'\xff' * max(0, offset - len(page)))
+        page[offset:offset + len(data)] = data
+
+    return pages.values()
+
+
+def format_time(frame):
+    if frame.utc:
+        t = datetime.datetime.utcfromtimestamp(frame.time_ms / 1000)
+        return t.strftime('%Y-%m-%dT%H:%M:%S.%f')[:-3] + 'Z'
+    return '{:.3f}'.format(frame.time_ms / 1000)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('input', help='dump file or tty device')
+    args = parser.parse_args()
+
+    with open(args.input, 'rb', buffering=0) as f:
+        pages = read_dump(f)
+
+    for page in pages:
+        try:
+            for frame in decode_page(page):
+                quality = '' if frame.quality is None \
+                    else ' q={}'.format(frame.quality)
+                # Like the empty NMEA channel field of such frames.
+                channel = '-' if frame.away else 'AB'[frame.channel]
+                print('{} {}{} {}'.format(
+                    format_time(frame), channel, quality,
+                    frame.payload.hex()))
+        except DecodeError as e:
+            print('error: {}'.format(e), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,278 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2020 Ievgenii Meshcheriakov
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""Compact a WDS generated radio configuration.
+
+Reads RADIO_CONFIGURATION_DATA_ARRAY from a header generated by Silicon
+Labs WDS and writes the same command stream, in the format consumed by
+si4362_send_init_commands(), with fewer SET_PROPERTY commands:
+
+  - properties written again with the value they already have are dropped,
+  - writes of neighbouring properties in a run of SET_PROPERTY commands are
+    merged into one command of at most 12 properties. Gaps are bridged
+    with properties whose value is known from earlier writes.
+
+Other commands are kept in place, SET_PROPERTY commands are never moved
+across them. Property values are forgotten at POWER_UP.
+
+    radio_config.py radio_config_ch1.h -o radio_config_ch1.inc
+
+With --base the output is a delta against the base configuration, which
+is processed the same way. si4362_send_init_commands() applies it, see
+struct si4362_stream in src/si4362.h for the format. Configurations for
+different channels differ in a few properties only:
+
+    radio_config.py radio_config_ch2.h --base radio_config_ch1.h \
+        -o radio_config_ch2_delta.inc
+
+For the IQ calibration cache, a configuration with calibration can be
+split into a stream that configures the radio without calibrating
+(--drop-calibration) and one that calibrates a radio that is already
+powered up (--drop-power-up).
+"""
+
+import argparse
+import difflib
+import re
+import sys
+
+CMD_POWER_UP = 0x02
+CMD_SET_PROPERTY = 0x11
+CMD_IRCAL = 0x17
+CMD_START_RX = 0x32
+# The command buffer holds 16 bytes: command, group, count, start.
+MAX_PROPERTIES = 12
+# Counts in a delta entry are bytes.
+MAX_DELTA_COUNT = 255
+
+
+class ConfigError(Exception):
+    pass
+
+
+def read_defines(text):
+    """Return a dict of object-like macros, the first definition wins."""
+    text = re.sub(r'\\\n', ' ', text)
+    defines = {}
+    for m in re.finditer(r'^\s*#\s*define\s+(\w+)(?!\()\s*(.*)$', text,
+                         re.MULTILINE):
+        defines.setdefault(m.group(1), m.group(2).strip())
+    return defines
+
+
+def expand(name, defines, depth=0):
+    if depth > 8:
+        raise ConfigError('macro nesting too deep at {}'.format(name))
+    values = []
+    body = defines[name].strip().strip('{}')
+    for token in body.split(','):
+        token = token.strip()
+        if not token:
+            continue
+        if token in defines:
+            values += expand(token, defines, depth + 1)
+        else:
+            values.append(int(token, 0))
+    return values
+
+
+def parse_stream(data):
+    """Split a length prefixed, zero terminated stream into commands."""
+    commands = []
+    pos = 0
+    while True:
+        if pos >= len(data):
+            raise ConfigError('missing terminator')
+        length = data[pos]
+        if length == 0:
+            return commands
+        commands.append(bytes(data[pos + 1:pos + 1 + length]))
+        pos += 1 + length
+
+
+def is_set_property(cmd):
+    return cmd[0] == CMD_SET_PROPERTY and len(cmd) == 4 + cmd[2]
+
+
+def compact_run(run, known):
+    """Rewrite a run of SET_PROPERTY commands."""
+    groups = []
+    writes = {}
+    for cmd in run:
+        group, start = cmd[1], cmd[3]
+        if group not in writes:
+            groups.append(group)
+            writes[group] = {}
+        for i, value in enumerate(cmd[4:]):
+            writes[group][start + i] = value
+
+    out = []
+    for group in groups:
+        state = known.setdefault(group, {})
+        needed = sorted(p for p, v in writes[group].items()
+                        if state.get(p) != v)
+        state.update(writes[group])
+
+        while needed:
+            first = needed[0]
+            last = first
+            for prop in needed[1:]:
+                if prop - first >= MAX_PROPERTIES or \
+                        any(p not in state for p in range(last + 1, prop)):
+                    break
+                last = prop
+            values = [state[p] for p in range(first, last + 1)]
+            out.append(bytes([CMD_SET_PROPERTY, group, len(values), first] +
+                             values))
+            needed = [p for p in needed if p > last]
+
+    return out
+
+
+def compact(commands):
+    out = []
+    known = {}
+    run = []
+    for cmd in commands + [None]:
+        if cmd is not None and is_set_property(cmd):
+            run.append(cmd)
+            continue
+        out += compact_run(run, known)
+        run = []
+        if cmd is None:
+            break
+        if cmd[0] == CMD_POWER_UP:
+            known = {}
+        out.append(cmd)
+    return out
+
+
+def drop_calibration(commands):
+    """Remove IRCAL and the START_RX commands that only serve it."""
+    last = len(commands) - 1
+    return [c for i, c in enumerate(commands)
+            if c[0] != CMD_IRCAL and (c[0] != CMD_START_RX or i == last)]
+
+
+def drop_power_up(commands):
+    return [c for c in commands if c[0] != CMD_POWER_UP]
+
+
+def delta(base, commands):
+    """Return the delta entries that turn base into commands.
+
+    An entry is (base commands to copy, base commands to skip, commands to
+    send instead).
+    """
+    entries = []
+    copy = 0
+    matcher = difflib.SequenceMatcher(None, base, commands, autojunk=False)
+    for tag, i1, i2, j1, j2 in matcher.get_opcodes():
+        if tag == 'equal':
+            copy += i2 - i1
+            continue
+        skip, insert = i2 - i1, commands[j1:j2]
+        while copy > MAX_DELTA_COUNT:
+            entries.append((MAX_DELTA_COUNT, 0, []))
+            copy -= MAX_DELTA_COUNT
+        while skip > MAX_DELTA_COUNT or len(insert) > MAX_DELTA_COUNT:
+            entries.append((copy, min(skip, MAX_DELTA_COUNT),
+                            insert[:MAX_DELTA_COUNT]))
+            copy = 0
+            skip = max(0, skip - MAX_DELTA_COUNT)
+            insert = insert[MAX_DELTA_COUNT:]
+        entries.append((copy, skip, insert))
+        copy = 0
+    return entries
+
+
+def apply_delta(base, entries):
+    out = []
+    pos = 0
+    for copy, skip, insert in entries:
+        out += base[pos:pos + copy]
+        pos += copy + skip
+        out += insert
+    return out + base[pos:]
+
+
+def delta_bytes(entries):
+    return sum(3 + stream_bytes(insert) - 1 for _, _, insert in entries) + 3
+
+
+def write_delta_inc(entries, f):
+    for copy, skip, insert in entries:
+        f.write('{}, {}, {},\n'.format(copy, skip, len(insert)))
+        write_commands(insert, f)
+    f.write('0, 0, 0,\n')
+
+
+def stream_bytes(commands):
+    return sum(1 + len(c) for c in commands) + 1
+
+
+def write_commands(commands, f):
+    for cmd in commands:
+        f.write(', '.join('0x{:02X}'.format(b)
+                          for b in bytes([len(cmd)]) + cmd) + ',\n')
+
+
+def write_inc(commands, f):
+    write_commands(commands, f)
+    f.write('0x00,\n')
+
+
+def load(header, args):
+    with open(header) as f:
+        defines = read_defines(f.read())
+
+    commands = parse_stream(expand('RADIO_CONFIGURATION_DATA_ARRAY', defines))
+    if args.drop_calibration:
+        commands = drop_calibration(commands)
+    if args.drop_power_up:
+        commands = drop_power_up(commands)
+    return commands
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('header', help='WDS generated radio_config.h')
+    parser.add_argument('-o', '--output', required=True,
+                        help='output file for an array initializer')
+    parser.add_argument('--base',
+                        help='write a delta against this configuration')
+    parser.add_argument('--drop-calibration', action='store_true',
+                        help='remove IRCAL commands')
+    parser.add_argument('--drop-power-up', action='store_true',
+                        help='remove POWER_UP commands')
+    args = parser.parse_args()
+
+    try:
+        commands = load(args.header, args)
+        compacted = compact(commands)
+        if args.base:
+            base = compact(load(args.base, args))
+            entries = delta(base, compacted)
+            assert apply_delta(base, entries) == compacted
+    except (ConfigError, KeyError, ValueError) as e:
+        sys.exit('{}: {}'.format(args.header, e))
+
+    with open(args.output, 'w') as f:
+        if args.base:
+            write_delta_inc(entries, f)
+        else:
+            write_inc(compacted, f)
+
+    print('{}: {} commands, {} bytes -> {} commands, {} bytes'.format(
+        args.header.split('/')[-1], len(commands), stream_bytes(commands),
+        len(compacted), stream_bytes(compacted)), end='')
+    if args.base:
+        print(', delta {} bytes'.format(delta_bytes(entries)), end='')
+    print()
+
+
+if __name__ == '__main__':
+    main()
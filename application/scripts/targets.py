@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2020 Ievgenii Meshcheriakov
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""Decoder for the vessel table snapshot (CONFIG_APP_TARGETS).
+
+Reads the base64 lines printed by the "targets snapshot" shell command,
+see src/targets.h for the layout:
+
+    targets.py < snapshot.txt
+"""
+
+import argparse
+import base64
+import struct
+import sys
+from collections import namedtuple
+
+from ais_binary import DecodeError, crc16_ccitt
+
+VERSION = 1
+HEADER = struct.Struct('<BBHI')
+ENTRY = struct.Struct('<IIiiHHHBB')
+
+Target = namedtuple('Target',
+                    'mmsi age_ms lon lat speed course heading type channel')
+
+
+def decode_snapshot(raw):
+    """Decode a snapshot into (uptime in ms, list of Target)."""
+    if len(raw) < HEADER.size + 2:
+        raise DecodeError('snapshot too short')
+
+    body, crc = raw[:-2], struct.unpack('<H', raw[-2:])[0]
+    if crc16_ccitt(body) != crc:
+        raise DecodeError('CRC mismatch')
+
+    version, entry_size, count, uptime_ms = HEADER.unpack_from(body)
+    if version != VERSION:
+        raise DecodeError('unsupported version {}'.format(version))
+    if entry_size < ENTRY.size or \
+            len(body) != HEADER.size + count * entry_size:
+        raise DecodeError('bad snapshot length')
+
+    targets = [Target(*ENTRY.unpack_from(body, HEADER.size + i * entry_size))
+               for i in range(count)]
+    return uptime_ms, targets
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('file', nargs='?', type=argparse.FileType('r'),
+                        default=sys.stdin)
+    args = parser.parse_args()
+
+    text = ''.join(line.strip() for line in args.file)
+    uptime_ms, targets = decode_snapshot(base64.b64decode(text))
+
+    print('uptime {:.1f} s, {} targets'.format(uptime_ms / 1000, len(targets)))
+    for t in targets:
+        print('{:09d} {} type {:2d} age {:5.0f} s lat {:10.6f} lon {:11.6f} '
+              'sog {:5.1f} cog {:5.1f} hdg {}'.format(
+                  t.mmsi, 'AB'[t.channel], t.type, t.age_ms / 1000,
+                  t.lat / 600000, t.lon / 600000, t.speed / 10,
+                  t.course / 10, t.heading))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <sys/byteorder.h>
+#include <sys/crc.h>
+
+#include "ais_binary.h"
+
+size_t cobs_encode(const uint8_t *src, size_t len, uint8_t *dst)
+{
+	uint8_t *code_p = dst;
+	uint8_t *p = dst + 1;
+	uint8_t code = 1;
+
+	for (size_t i = 0; i < len; i++) {
+		if (src[i] == 0) {
+			*code_p = code;
+			code_p = p++;
+			code = 1;
+			continue;
+		}
+
+		*p++ = src[i];
+		code++;
+
+		if (code == 0xff) {
+			*code_p = code;
+			code_p = p++;
+			code = 1;
+		}
+	}
+
+	*code_p = code;
+
+	return p - dst;
+}
+
+size_t ais_binary_encode(const struct ais_frame *frame, uint8_t *buf)
+{
+	uint8_t raw[AIS_BINARY_MAX_RAW_LENGTH];
+	uint8_t *p = raw;
+	size_t len = MIN(frame->len, AIS_BINARY_MAX_PAYLOAD);
+
+	*p++ = frame->channel;
+	*p++ = frame->flags;
+	sys_put_le16(len * 8, p);
+	p += 2;
+	sys_put_le32((uint32_t)frame->time_us, p);
+	p += 4;
+
+	if (frame->flags & AIS_FRAME_HAS_QUALITY) {
+		*p++ = (uint8_t)frame->quality;
+	}
+
+	memcpy(p, frame->data, len);
+	p += len;
+
+	sys_put_le16(crc16_ccitt(0xffff, raw, p - raw), p);
+	p += 2;
+
+	__ASSERT_NO_MSG((size_t)(p - raw) <= sizeof(raw));
+
+	size_t out_len = cobs_encode(raw, p - raw, buf);
+	buf[out_len++] = 0;
+
+	return out_len;
+}
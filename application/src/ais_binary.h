@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef APPLICATION_SRC_AIS_BINARY_H_
+#define APPLICATION_SRC_AIS_BINARY_H_
+
+#include "ais_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Binary record layout before COBS encoding, all fields little endian:
+ *
+ *   u8  channel
+ *   u8  flags (AIS_FRAME_* flags)
+ *   u16 payload length in bits
+ *   u32 receive time, microseconds since boot (lower 32 bits)
+ *   i8  quality, only present with AIS_FRAME_HAS_QUALITY
+ *   ... payload bytes
+ *   u16 CRC-16/CCITT (crc16_ccitt() seeded with 0xffff) of all of the above
+ *
+ * The record is then COBS encoded and terminated with a zero byte.
+ */
+
+#define AIS_BINARY_HEADER_LENGTH 8
+#define AIS_BINARY_MAX_PAYLOAD 128
+#define AIS_BINARY_MAX_RAW_LENGTH \
+	(AIS_BINARY_HEADER_LENGTH + 1 + AIS_BINARY_MAX_PAYLOAD + 2)
+/* One COBS overhead byte per 254 bytes plus the delimiter. */
+#define AIS_BINARY_MAX_LENGTH \
+	(AIS_BINARY_MAX_RAW_LENGTH + \
+	 ceiling_fraction(AIS_BINARY_MAX_RAW_LENGTH, 254) + 1)
+
+/**
+ * Encode a frame as a COBS framed binary record.
+ *
+ * @param frame Frame to encode.
+ * @param buf Output buffer of at least AIS_BINARY_MAX_LENGTH bytes.
+ *
+ * @return Number of bytes written including the delimiter.
+ */
+size_t ais_binary_encode(const struct ais_frame *frame, uint8_t *buf);
+
+/**
+ * COBS encode a buffer.
+ *
+ * The output buffer must hold len + len / 254 + 1 bytes. No delimiter is
+ * appended.
+ *
+ * @return Number of bytes written.
+ */
+size_t cobs_encode(const uint8_t *src, size_t len, uint8_t *dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
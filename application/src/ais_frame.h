@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef APPLICATION_SRC_AIS_FRAME_H_
+#define APPLICATION_SRC_AIS_FRAME_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/util.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AIS_NUM_CHANNELS 2
+
+/** Frame carries a valid quality value. */
+#define AIS_FRAME_HAS_QUALITY BIT(0)
+/*
+ * The radio of the channel was tuned to another frequency of the channel
+ * plan when the frame was received.
+ */
+#define AIS_FRAME_AWAY BIT(1)
+
+/**
+ * A decoded AIS frame as reported by the HDLC decoder.
+ *
+ * The payload is not owned by this structure, it points to the decoder
+ * buffer and is only valid during the HDLC callback.
+ */
+struct ais_frame {
+	/** Time of the end-of-frame bit in microseconds since boot. */
+	uint64_t time_us;
+	/** Payload bytes without FCS. */
+	const uint8_t *data;
+	/** Frame check sequence as received. */
+	uint16_t fcs;
+	/** Payload length in bytes. */
+	uint8_t len;
+	/** Zeros stuffed into the payload and FCS on the air. */
+	uint8_t stuffed_bits;
+	/**
+	 * Channel index, 0 for AIS 1 (A), 1 for AIS 2 (B). With AIS_FRAME_AWAY
+	 * this is the radio the frame was received with.
+	 */
+	uint8_t channel;
+	/** AIS_FRAME_* flags. */
+	uint8_t flags;
+	/**
+	 * Signal quality, valid with AIS_FRAME_HAS_QUALITY. This is the RSSI
+	 * in dBm read at the start of the frame.
+	 */
+	int8_t quality;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
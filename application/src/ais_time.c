@@ -0,0 +1,406 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <shell/shell.h>
+#include <ais_msg.h>
+
+#include "ais_time.h"
+
+#define LOG_LEVEL CONFIG_LOG_DEFAULT_LEVEL
+#include <logging/log.h>
+LOG_MODULE_REGISTER(ais_time);
+
+/* One bit at 9600 bit/s is 625/6 us, one slot is 80000/3 us. */
+#define BITS_TO_US(n) ((n) * 625 / 6)
+#define SLOT_US_NUM 80000
+#define SLOT_US_DEN 3
+
+/* Ramp up, training sequence and start flag, then FCS and end flag. */
+#define FRAME_OVERHEAD_BITS (8 + 24 + 8 + 16 + 8)
+/*
+ * Stuffed bits are counted by the decoder, this covers the transmit timing
+ * tolerance and the receive latency.
+ */
+#define SYNC_JITTER_US 1000
+/* Tolerance of the crystal, the window grows by this much between reports. */
+#define MAX_DRIFT_PPM 100
+#define DRIFT_MIN_INTERVAL_US (300 * USEC_PER_SEC)
+
+#define MINUTE_US (60LL * USEC_PER_SEC)
+#define DAY_US (24 * 60 * MINUTE_US)
+#define SLOTS_PER_MINUTE 2250
+
+/* SOTDMA communication state, ITU-R M.1371 annex 2, 3.3.7.2.2. */
+#define COMM_SYNC_STATE(cs) (((cs) >> 17) & 0x3)
+#define COMM_SLOT_TIMEOUT(cs) (((cs) >> 14) & 0x7)
+#define COMM_SUB_MESSAGE(cs) ((cs) & 0x3fff)
+/* UTC direct, UTC indirect and synchronized to a base station. */
+#define COMM_SYNC_MAX 2
+/* Type 18 uses ITDMA when the selector flag above the state is set. */
+#define COMM_ITDMA_SELECTOR BIT(19)
+
+/* Messages are parsed up to the end of the communication state. */
+#define COMM_STATE_BYTES 21
+
+struct time_state {
+	/** UTC minus local time is within [lo, hi]. */
+	int64_t lo;
+	int64_t hi;
+	/** Local time the window was last updated at. */
+	uint64_t window_local;
+	bool window_valid;
+
+	/** Offset snapped to the slot grid. */
+	bool synced;
+	int64_t offset;
+	uint64_t ref_local;
+	int32_t drift_ppb;
+
+	/** Previous snapped offset for drift estimation. */
+	bool drift_ref_valid;
+	bool drift_valid;
+	int64_t drift_offset;
+	uint64_t drift_local;
+
+	uint32_t reports;
+	uint32_t slot_numbers;
+	uint32_t resyncs;
+};
+
+static struct time_state state;
+static struct k_spinlock lock;
+
+static int64_t days_from_civil(int y, unsigned int m, unsigned int d)
+{
+	/* Only years after 2000 are accepted, no negative eras. */
+	y -= m <= 2;
+	unsigned int era = y / 400;
+	unsigned int yoe = y - era * 400;
+	unsigned int doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+	unsigned int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return (int64_t)era * 146097 + doe - 719468;
+}
+
+static bool base_station_utc(const struct ais_msg_base_station *bs,
+			     int64_t *utc_s)
+{
+	/* Not available values are 0, 0, 0, 24, 60, 60. */
+	if (bs->year < 2000 || bs->month < 1 || bs->month > 12 ||
+	    bs->day < 1 || bs->day > 31 || bs->hour > 23 ||
+	    bs->minute > 59 || bs->second > 59) {
+		return false;
+	}
+
+	*utc_s = days_from_civil(bs->year, bs->month, bs->day) * 86400 +
+		 bs->hour * 3600 + bs->minute * 60 + bs->second;
+
+	return true;
+}
+
+static void update_drift(uint64_t t)
+{
+	if (!state.drift_ref_valid) {
+		goto set_ref;
+	}
+
+	if (t - state.drift_local < DRIFT_MIN_INTERVAL_US) {
+		return;
+	}
+
+	int32_t drift = (state.offset - state.drift_offset) * 1000000000LL /
+			(int64_t)(t - state.drift_local);
+
+	if (state.drift_valid) {
+		drift = state.drift_ppb + (drift - state.drift_ppb) / 4;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	state.drift_ppb = drift;
+	k_spin_unlock(&lock, key);
+	state.drift_valid = true;
+
+set_ref:
+	state.drift_ref_valid = true;
+	state.drift_offset = state.offset;
+	state.drift_local = t;
+}
+
+/* Grow the window by the drift the local clock may have had since. */
+static void widen_window(uint64_t t)
+{
+	int64_t elapsed = (int64_t)(t - state.window_local);
+
+	/* Frames of the other channel may be decoded out of order. */
+	if (elapsed <= 0) {
+		return;
+	}
+
+	int64_t widen = elapsed * MAX_DRIFT_PPM / 1000000;
+
+	state.lo -= widen;
+	state.hi += widen;
+	state.window_local = t;
+}
+
+static void update_window(int64_t utc_s, uint64_t t)
+{
+	int64_t lo = utc_s * USEC_PER_SEC - (int64_t)t - SYNC_JITTER_US;
+	int64_t hi = lo + USEC_PER_SEC + 2 * SYNC_JITTER_US;
+
+	if (state.window_valid) {
+		widen_window(t);
+
+		state.lo = MAX(state.lo, lo);
+		state.hi = MIN(state.hi, hi);
+
+		if (state.lo > state.hi) {
+			LOG_WRN("UTC jumped, resynchronizing");
+			state.resyncs++;
+			state.window_valid = false;
+			state.drift_ref_valid = false;
+
+			k_spinlock_key_t key = k_spin_lock(&lock);
+			state.synced = false;
+			k_spin_unlock(&lock, key);
+		}
+	}
+
+	if (!state.window_valid) {
+		state.lo = lo;
+		state.hi = hi;
+		state.window_valid = true;
+		state.window_local = t;
+	}
+}
+
+static void set_offset(uint64_t t, int64_t offset)
+{
+	if (!state.synced) {
+		LOG_INF("UTC synchronized");
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	state.synced = true;
+	state.offset = offset;
+	state.ref_local = t;
+	k_spin_unlock(&lock, key);
+
+	state.lo = offset - SYNC_JITTER_US;
+	state.hi = offset + SYNC_JITTER_US;
+	state.window_local = t;
+
+	update_drift(t);
+}
+
+/* Slot boundary at or after a UTC time in microseconds. */
+static inline int64_t next_slot(int64_t utc_us)
+{
+	return (utc_us * SLOT_US_DEN + SLOT_US_NUM - 1) / SLOT_US_NUM;
+}
+
+static inline int64_t floor_mod(int64_t x, int64_t m)
+{
+	return ((x % m) + m) % m;
+}
+
+/* Snap a window that has narrowed down to a single slot boundary. */
+static void snap_to_slot(uint64_t t)
+{
+	int64_t slot = next_slot((int64_t)t + state.lo);
+
+	/* The report started at a slot boundary, it must be the only one. */
+	if (slot != next_slot((int64_t)t + state.hi + 1) - 1) {
+		return;
+	}
+
+	set_offset(t, slot * SLOT_US_NUM / SLOT_US_DEN - (int64_t)t);
+}
+
+/*
+ * The frame was sent in a known slot of the UTC minute. That fixes the
+ * offset modulo a minute, the window picks the minute.
+ */
+static bool resolve_slot(uint64_t t, uint32_t slot)
+{
+	if (slot >= SLOTS_PER_MINUTE) {
+		return false;
+	}
+
+	int64_t phase = (int64_t)slot * SLOT_US_NUM / SLOT_US_DEN - (int64_t)t;
+	int64_t offset = state.lo + floor_mod(phase - state.lo, MINUTE_US);
+
+	/* A station that disagrees with the base stations is ignored. */
+	if (offset > state.hi) {
+		return false;
+	}
+
+	state.slot_numbers++;
+	set_offset(t, offset);
+
+	return true;
+}
+
+/* The frame was sent in a known minute of the UTC day. */
+static void bound_to_minute(uint64_t t, uint32_t hour, uint32_t minute)
+{
+	if (hour > 23 || minute > 59) {
+		return;
+	}
+
+	int64_t utc = (int64_t)t + state.lo;
+	int64_t start = utc - floor_mod(utc, DAY_US) +
+			(int64_t)(hour * 60 + minute) * MINUTE_US - (int64_t)t;
+
+	/* The window may be close to midnight. */
+	if (start - state.lo > DAY_US / 2) {
+		start -= DAY_US;
+	} else if (state.lo - start > DAY_US / 2) {
+		start += DAY_US;
+	}
+
+	int64_t lo = MAX(state.lo, start - SYNC_JITTER_US);
+	int64_t hi = MIN(state.hi, start + MINUTE_US + SYNC_JITTER_US);
+
+	if (lo <= hi) {
+		state.lo = lo;
+		state.hi = hi;
+	}
+}
+
+/* SOTDMA communication state of a message, false if there is none. */
+static bool comm_state(const struct ais_msg *msg, uint32_t *cs)
+{
+	switch (msg->type) {
+	case 1:
+	case 2:
+		*cs = msg->class_a.pos.radio;
+		return true;
+	case 4:
+	case 11:
+		*cs = msg->base_station.radio;
+		return true;
+	case 18:
+		*cs = msg->class_b.pos.radio;
+		return !(*cs & COMM_ITDMA_SELECTOR);
+	default:
+		return false;
+	}
+}
+
+void ais_time_update(const struct ais_frame *frame)
+{
+	uint8_t buf[COMM_STATE_BYTES + AIS_MSG_BUFFER_PADDING] = { 0 };
+	uint8_t type = frame->data[0] >> 2;
+	struct ais_msg msg;
+	int64_t utc_s;
+	uint32_t cs;
+
+	if (frame->len < COMM_STATE_BYTES ||
+	    (type != 1 && type != 2 && type != 4 && type != 11 &&
+	     type != 18)) {
+		return;
+	}
+
+	/* All of these are 168 bits, nothing else is needed. */
+	memcpy(buf, frame->data, COMM_STATE_BYTES);
+
+	if (ais_msg_parse(buf, COMM_STATE_BYTES, &msg) < 0) {
+		return;
+	}
+
+	/* Local time at the start of the slot the frame was sent in. */
+	uint64_t t = frame->time_us -
+		     BITS_TO_US(FRAME_OVERHEAD_BITS + frame->len * 8 +
+				frame->stuffed_bits);
+
+	/* Only base stations carry the date. */
+	if ((type == 4 || type == 11) &&
+	    base_station_utc(&msg.base_station, &utc_s)) {
+		state.reports++;
+		update_window(utc_s, t);
+	}
+
+	if (!state.window_valid) {
+		return;
+	}
+
+	widen_window(t);
+
+	if (comm_state(&msg, &cs) && COMM_SYNC_STATE(cs) <= COMM_SYNC_MAX) {
+		switch (COMM_SLOT_TIMEOUT(cs)) {
+		case 1:
+			bound_to_minute(t, COMM_SUB_MESSAGE(cs) >> 9,
+					(COMM_SUB_MESSAGE(cs) >> 2) & 0x7f);
+			break;
+		case 2:
+		case 4:
+		case 6:
+			if (resolve_slot(t, COMM_SUB_MESSAGE(cs))) {
+				return;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	snap_to_slot(t);
+}
+
+int ais_time_from_local(uint64_t local_us, uint64_t *utc_us)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	bool synced = state.synced;
+	int64_t offset = state.offset;
+	int64_t elapsed = (int64_t)(local_us - state.ref_local);
+	int32_t drift_ppb = state.drift_ppb;
+	k_spin_unlock(&lock, key);
+
+	if (!synced) {
+		return -EAGAIN;
+	}
+
+	*utc_us = local_us + offset + elapsed * drift_ppb / 1000000000LL;
+
+	return 0;
+}
+
+int ais_time_now(uint64_t *utc_us)
+{
+	return ais_time_from_local(k_ticks_to_us_floor64(k_uptime_ticks()),
+				   utc_us);
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_utc(const struct shell *shell, size_t argc, char **argv)
+{
+	uint64_t utc_us;
+
+	if (ais_time_now(&utc_us) == 0) {
+		shell_print(shell, "utc: %u.%06u",
+			    (uint32_t)(utc_us / USEC_PER_SEC),
+			    (uint32_t)(utc_us % USEC_PER_SEC));
+	} else if (state.window_valid) {
+		shell_print(shell, "utc: not synchronized, window %u ms",
+			    (uint32_t)((state.hi - state.lo) / USEC_PER_MSEC));
+	} else {
+		shell_print(shell, "utc: no base station heard");
+	}
+
+	shell_print(shell, "drift: %d ppb%s", state.drift_ppb,
+		    state.drift_valid ? "" : " (not estimated)");
+	shell_print(shell, "reports: %u, slot numbers: %u, resyncs: %u",
+		    state.reports, state.slot_numbers, state.resyncs);
+
+	return 0;
+}
+
+SHELL_CMD_REGISTER(utc, NULL, "Show UTC derived from base stations",
+		   cmd_utc);
+#endif
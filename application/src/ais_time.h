@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef APPLICATION_SRC_AIS_TIME_H_
+#define APPLICATION_SRC_AIS_TIME_H_
+
+#include <stdint.h>
+#include "ais_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Feed a frame to the time keeping service.
+ *
+ * Base station reports (types 4 and 11) carry UTC with one second
+ * resolution, every report bounds the offset between UTC and local time
+ * to a one second window. SOTDMA frames (types 1, 2, 4, 11 and 18) of
+ * stations synchronized to UTC or to a base station carry the number of
+ * the slot they were sent in with three of every eight frames. That places
+ * the start of the frame within the window on the 26.67 ms slot grid. The
+ * hour and minute carried by another one of the eight narrow the window
+ * after a long gap. The drift of the local clock
+ * is estimated from offsets a few minutes apart.
+ *
+ * Must be called from a single thread, the decoding thread.
+ */
+void ais_time_update(const struct ais_frame *frame);
+
+/**
+ * Convert local time, as in ais_frame::time_us, to UTC.
+ *
+ * @param local_us Local time in microseconds.
+ * @param utc_us Microseconds since the UNIX epoch.
+ *
+ * @return 0 on success, -EAGAIN if UTC is not known yet.
+ */
+int ais_time_from_local(uint64_t local_us, uint64_t *utc_us);
+
+/** Current UTC in microseconds since the UNIX epoch, see above. */
+int ais_time_now(uint64_t *utc_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
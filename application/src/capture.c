@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <sys/atomic.h>
+#include <sys/byteorder.h>
+#include <sys/crc.h>
+#include <shell/shell.h>
+
+#include "ais_frame.h"
+#include "ais_binary.h"
+#include "capture.h"
+#include "streams.h"
+
+#define LOG_LEVEL CONFIG_LOG_DEFAULT_LEVEL
+#include <logging/log.h>
+LOG_MODULE_REGISTER(capture);
+
+#define CAPTURE_HEADER_LENGTH 5
+#define CAPTURE_RAW_LENGTH (CAPTURE_HEADER_LENGTH + CAPTURE_BLOCK_SIZE + 2)
+
+struct capture_channel {
+	uint16_t seq;
+	uint16_t num_bits;
+	uint8_t data[CAPTURE_BLOCK_SIZE];
+};
+
+static struct capture_channel channels[AIS_NUM_CHANNELS];
+static atomic_t mode = ATOMIC_INIT(CAPTURE_OFF);
+static atomic_t restart;
+
+static uint8_t raw[CAPTURE_RAW_LENGTH];
+static uint8_t encoded[CAPTURE_RAW_LENGTH + 2];
+
+enum capture_mode capture_get_mode(void)
+{
+	return atomic_get(&mode);
+}
+
+void capture_set_mode(enum capture_mode new_mode)
+{
+	if (atomic_set(&mode, new_mode) == CAPTURE_OFF) {
+		atomic_set(&restart, 1);
+	}
+}
+
+static void flush_channel(uint8_t index, struct capture_channel *ch)
+{
+	uint8_t *p = raw;
+	size_t len = ceiling_fraction(ch->num_bits, 8);
+
+	*p++ = index;
+	sys_put_le16(ch->seq, p);
+	p += 2;
+	sys_put_le16(ch->num_bits, p);
+	p += 2;
+	memcpy(p, ch->data, len);
+	p += len;
+	sys_put_le16(crc16_ccitt(0xffff, raw, p - raw), p);
+	p += 2;
+
+	size_t out_len = cobs_encode(raw, p - raw, encoded);
+	encoded[out_len++] = 0;
+
+	if (stream_write(STREAM_CAPTURE, encoded, out_len, K_NO_WAIT) < 0) {
+		LOG_DBG("capture block %u dropped", ch->seq);
+	}
+
+	ch->seq++;
+	ch->num_bits = 0;
+}
+
+void capture_bit(uint8_t channel, int raw_bit)
+{
+	if (atomic_cas(&restart, 1, 0)) {
+		for (int i = 0; i < ARRAY_SIZE(channels); i++) {
+			channels[i].num_bits = 0;
+		}
+	}
+
+	struct capture_channel *ch = &channels[channel];
+	uint16_t byte_idx = ch->num_bits / 8;
+	uint8_t mask = BIT(ch->num_bits % 8);
+
+	if (mask == 1) {
+		ch->data[byte_idx] = 0;
+	}
+
+	if (raw_bit) {
+		ch->data[byte_idx] |= mask;
+	}
+
+	ch->num_bits++;
+
+	if (ch->num_bits == CAPTURE_BLOCK_SIZE * 8) {
+		flush_channel(channel, ch);
+	}
+}
+
+static const char *const mode_names[] = {
+	[CAPTURE_OFF] = "off",
+	[CAPTURE_ON] = "on",
+	[CAPTURE_ONLY] = "only",
+};
+
+static int cmd_capture(const struct shell *shell, size_t argc, char **argv)
+{
+	if (argc < 2) {
+		shell_print(shell, "%s", mode_names[capture_get_mode()]);
+		return 0;
+	}
+
+	for (int i = 0; i < ARRAY_SIZE(mode_names); i++) {
+		if (strcmp(argv[1], mode_names[i]) == 0) {
+			capture_set_mode(i);
+			return 0;
+		}
+	}
+
+	shell_error(shell, "unknown mode: %s", argv[1]);
+	return -EINVAL;
+}
+
+SHELL_CMD_ARG_REGISTER(capture, NULL,
+	"Raw bitstream capture: capture [off|on|only]",
+	cmd_capture, 1, 1);
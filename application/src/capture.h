@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef APPLICATION_SRC_CAPTURE_H_
+#define APPLICATION_SRC_CAPTURE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Capture record layout before COBS encoding, all fields little endian:
+ *
+ *   u8  channel
+ *   u16 sequence number, incremented per channel
+ *   u16 number of bits
+ *   ... raw radio bits, packed LSB first
+ *   u16 CRC-16/CCITT (crc16_ccitt() seeded with 0xffff) of all of the above
+ *
+ * The record is then COBS encoded and terminated with a zero byte. Payloads
+ * of one channel concatenated produce the same layout as the HDLC test
+ * bitstream, see scripts/capture_split.py.
+ */
+
+#define CAPTURE_BLOCK_SIZE 32
+
+enum capture_mode {
+	/** Capture disabled, normal decoding. */
+	CAPTURE_OFF,
+	/** Capture alongside normal decoding. */
+	CAPTURE_ON,
+	/** Capture only, decoding is suspended. */
+	CAPTURE_ONLY,
+};
+
+enum capture_mode capture_get_mode(void);
+void capture_set_mode(enum capture_mode mode);
+
+/** Store a raw bit received on a channel, called from the decoding thread. */
+void capture_bit(uint8_t channel, int raw_bit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
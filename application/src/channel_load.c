@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <shell/shell.h>
+
+#include "ais_frame.h"
+#include "ais_time.h"
+#include "channel_load.h"
+
+#define SLOTS_PER_MINUTE 2250
+/* One slot is 80000/3 us, 256 bits at 9600 bit/s. */
+#define SLOT_US_NUM 80000
+#define SLOT_US_DEN 3
+#define SLOT_BITS 256
+#define BITS_TO_US(n) ((n) * 625 / 6)
+/* Ramp up, training sequence, start flag and end flag. */
+#define FRAME_OVERHEAD_BITS (8 + 24 + 8 + 8)
+/* Longest transmission allowed. */
+#define MAX_SLOTS 5
+#define HISTORY_SIZE CONFIG_APP_CHANNEL_LOAD_HISTORY
+
+struct load_summary {
+	uint32_t minute;
+	uint16_t occupied;
+	/** Slots the radio was tuned to another channel. */
+	uint16_t unobserved;
+	uint16_t frames;
+	uint16_t collisions;
+};
+
+struct channel_load {
+	/** Summary of the current minute. */
+	struct load_summary cur;
+	bool started;
+	uint8_t slots[ceiling_fraction(SLOTS_PER_MINUTE, 8)];
+	/** Completed minutes, oldest first once full. */
+	struct load_summary history[HISTORY_SIZE];
+	uint8_t head;
+	uint8_t count;
+};
+
+static struct channel_load channels[AIS_NUM_CHANNELS];
+static struct k_spinlock lock;
+
+static void finish_minute(struct channel_load *ch, uint32_t minute)
+{
+	if (ch->started) {
+		ch->history[ch->head] = ch->cur;
+		ch->head = (ch->head + 1) % HISTORY_SIZE;
+		ch->count = MIN(ch->count + 1, HISTORY_SIZE);
+	}
+
+	memset(&ch->cur, 0, sizeof(ch->cur));
+	memset(ch->slots, 0, sizeof(ch->slots));
+	ch->cur.minute = minute;
+	ch->started = true;
+}
+
+/* Slot nearest to a local time, of UTC when it is known. */
+static uint64_t nearest_slot(uint64_t local_us)
+{
+#ifdef CONFIG_APP_TIME
+	ais_time_from_local(local_us, &local_us);
+#endif
+
+	return (local_us * SLOT_US_DEN + SLOT_US_NUM / 2) / SLOT_US_NUM;
+}
+
+void channel_load_update(uint8_t channel, uint64_t end_us, uint16_t num_bits,
+			 bool valid)
+{
+	struct channel_load *ch = &channels[channel];
+	uint32_t air_bits = num_bits + FRAME_OVERHEAD_BITS;
+
+	/* Transmissions start at a slot boundary, round to the nearest one. */
+	uint64_t slot = nearest_slot(end_us - BITS_TO_US(air_bits));
+	uint32_t minute = slot / SLOTS_PER_MINUTE;
+	uint16_t first = slot % SLOTS_PER_MINUTE;
+	uint16_t num_slots = MIN(ceiling_fraction(air_bits, SLOT_BITS), MAX_SLOTS);
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	if (!ch->started || minute != ch->cur.minute) {
+		finish_minute(ch, minute);
+	}
+
+	if (valid) {
+		ch->cur.frames++;
+	} else {
+		ch->cur.collisions++;
+	}
+
+	/* Slots running into the next minute are not accounted. */
+	for (uint16_t i = first;
+	     i < MIN(first + num_slots, SLOTS_PER_MINUTE); i++) {
+		uint8_t mask = BIT(i % 8);
+
+		if (!(ch->slots[i / 8] & mask)) {
+			ch->slots[i / 8] |= mask;
+			ch->cur.occupied++;
+		}
+	}
+
+	k_spin_unlock(&lock, key);
+}
+
+void channel_load_unobserved(uint8_t channel, uint64_t start_us,
+			     uint16_t num_slots)
+{
+	struct channel_load *ch = &channels[channel];
+	uint64_t slot = nearest_slot(start_us);
+	uint32_t minute = slot / SLOTS_PER_MINUTE;
+	uint16_t first = slot % SLOTS_PER_MINUTE;
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	if (!ch->started || minute != ch->cur.minute) {
+		finish_minute(ch, minute);
+	}
+
+	ch->cur.unobserved = MIN(ch->cur.unobserved +
+				 MIN(num_slots, SLOTS_PER_MINUTE - first),
+				 SLOTS_PER_MINUTE);
+
+	k_spin_unlock(&lock, key);
+}
+
+#ifdef CONFIG_SHELL
+static void print_summary(const struct shell *shell, char name,
+			  const struct load_summary *s, bool current)
+{
+	uint16_t observed = SLOTS_PER_MINUTE - s->unobserved;
+	uint32_t permille = s->occupied * 1000U / MAX(observed, 1);
+
+	shell_print(shell, "%c %10u%c %4u %4u %3u.%u%% %6u %5u", name,
+		    s->minute, current ? '*' : ' ', s->occupied, observed,
+		    permille / 10, permille % 10, s->frames, s->collisions);
+}
+
+static int cmd_load(const struct shell *shell, size_t argc, char **argv)
+{
+	static struct load_summary history[HISTORY_SIZE];
+
+	shell_print(shell, "ch     minute  slots seen   load frames  coll");
+
+	for (int i = 0; i < AIS_NUM_CHANNELS; i++) {
+		const struct channel_load *ch = &channels[i];
+
+		k_spinlock_key_t key = k_spin_lock(&lock);
+		struct load_summary cur = ch->cur;
+		bool started = ch->started;
+		uint8_t count = ch->count;
+		uint8_t idx = (ch->head + HISTORY_SIZE - count) % HISTORY_SIZE;
+
+		for (int j = 0; j < count; j++) {
+			history[j] = ch->history[idx];
+			idx = (idx + 1) % HISTORY_SIZE;
+		}
+		k_spin_unlock(&lock, key);
+
+		for (int j = 0; j < count; j++) {
+			print_summary(shell, 'A' + i, &history[j], false);
+		}
+
+		if (started) {
+			print_summary(shell, 'A' + i, &cur, true);
+		}
+	}
+
+	shell_print(shell, "* minute in progress");
+
+	return 0;
+}
+
+SHELL_CMD_REGISTER(load, NULL, "Show per minute channel load", cmd_load);
+#endif
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef APPLICATION_SRC_CHANNEL_LOAD_H_
+#define APPLICATION_SRC_CHANNEL_LOAD_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Account a received packet in the channel load statistics.
+ *
+ * Marks the slots covered by the packet as occupied in a per minute bitmap
+ * of 2250 slots. Packets that were framed but failed the FCS check are
+ * counted as collisions. When a packet falls into a new minute the previous
+ * minute is summarized into a history shown by the "load" shell command.
+ * Slots are aligned to UTC when CONFIG_APP_TIME is synchronized, to local
+ * time otherwise. Constant time.
+ *
+ * @param channel Channel index.
+ * @param end_us Local time of the end of the packet.
+ * @param num_bits Number of bits between the flags, including the FCS.
+ * @param valid false if the FCS check failed.
+ */
+void channel_load_update(uint8_t channel, uint64_t end_us, uint16_t num_bits,
+			 bool valid);
+
+/**
+ * Account slots during which the radio of a channel listened elsewhere.
+ * The load is relative to the slots that were observed.
+ *
+ * @param channel Channel index.
+ * @param start_us Local time of the first slot.
+ * @param num_slots Number of slots, clipped to the minute.
+ */
+void channel_load_unobserved(uint8_t channel, uint64_t start_us,
+			     uint16_t num_slots);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <stdlib.h>
+#include <shell/shell.h>
+#include <sys/atomic.h>
+
+#include "ais_time.h"
+#include "channel_load.h"
+#include "channel_plan.h"
+#include "si4362.h"
+
+#define LOG_LEVEL CONFIG_LOG_DEFAULT_LEVEL
+#include <logging/log.h>
+LOG_MODULE_REGISTER(channel_plan);
+
+#define MAX_ENTRIES 8
+
+/* AIS 1 and the channel spacing to AIS 2. */
+#define AIS1_HZ 161975000
+#define AIS_CHANNEL_STEP_HZ 50000
+
+/* A minute has 2250 slots, one slot is 80000 / 3 us. */
+#define SLOTS_PER_MINUTE 2250
+#define SLOT_US_NUM 80000
+#define SLOT_US_DEN 3
+
+/*
+ * The PLL settles in a few hundred us, the state is asked for at this
+ * interval instead of keeping the bus busy.
+ */
+#define RETUNE_POLL_US 150
+
+struct entry {
+	uint32_t hz;
+	uint16_t slots;
+};
+
+static struct entry plan[MAX_ENTRIES];
+static size_t plan_len;
+static uint32_t cycle_slots;
+
+static const struct device *radio;
+static uint32_t home_hz;
+static uint8_t radio_channel;
+static atomic_t away;
+static int current = -1;
+
+static struct channel_plan_stats stats;
+static struct k_spinlock lock;
+/* Held while the radio is retuned or configured by someone else. */
+static K_MUTEX_DEFINE(radio_mutex);
+
+static void plan_thread(void *p1, void *p2, void *p3);
+
+K_THREAD_DEFINE(channel_plan, CONFIG_APP_CHANNEL_PLAN_STACK_SIZE,
+		plan_thread, NULL, NULL, NULL,
+		CONFIG_APP_CHANNEL_PLAN_PRIORITY, 0, SYS_FOREVER_MS);
+
+/* Parse "hz:slots,hz:slots...". */
+static int parse_plan(const char *str)
+{
+	const char *p = str;
+
+	plan_len = 0;
+	cycle_slots = 0;
+
+	while (*p != '\0') {
+		char *end;
+
+		if (plan_len == ARRAY_SIZE(plan)) {
+			return -ENOMEM;
+		}
+
+		unsigned long hz = strtoul(p, &end, 10);
+		if (end == p || *end != ':') {
+			return -EINVAL;
+		}
+
+		p = end + 1;
+		unsigned long slots = strtoul(p, &end, 10);
+		if (end == p || slots == 0 || slots > SLOTS_PER_MINUTE) {
+			return -EINVAL;
+		}
+
+		plan[plan_len].hz = hz;
+		plan[plan_len].slots = slots;
+		plan_len++;
+		cycle_slots += slots;
+
+		p = end;
+		if (*p == ',') {
+			p++;
+		} else if (*p != '\0') {
+			return -EINVAL;
+		}
+	}
+
+	return plan_len > 0 ? 0 : -EINVAL;
+}
+
+/* Current time in us, UTC if known. */
+static uint64_t now_us(void)
+{
+#ifdef CONFIG_APP_TIME
+	uint64_t utc_us;
+
+	if (ais_time_now(&utc_us) == 0) {
+		return utc_us;
+	}
+#endif
+	return k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+static void retune(int index)
+{
+	const uint32_t hz = plan[index].hz;
+	uint32_t start = k_cycle_get_32();
+	uint32_t us;
+	uint8_t state = 0;
+
+	k_mutex_lock(&radio_mutex, K_FOREVER);
+	atomic_set(&away, hz != home_hz);
+
+	int ret = si4362_set_frequency(radio, hz);
+
+	/* The radio goes through RX_TUNE while the PLL settles. */
+	while (ret == 0) {
+		k_usleep(RETUNE_POLL_US);
+
+		ret = si4362_get_state(radio, &state);
+		us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+
+		if (ret == 0 && state == SI4362_STATE_RX) {
+			break;
+		}
+
+		if (us > SLOT_US_NUM / SLOT_US_DEN) {
+			ret = -ETIMEDOUT;
+		}
+	}
+
+	us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+	current = index;
+	k_mutex_unlock(&radio_mutex);
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	stats.retunes++;
+	stats.last_retune_us = us;
+	stats.max_retune_us = MAX(stats.max_retune_us, us);
+	if (ret < 0) {
+		stats.failures++;
+	}
+	k_spin_unlock(&lock, key);
+
+	if (ret < 0) {
+		LOG_ERR("%s: retune to %u Hz failed (%d), state %u",
+			radio->name, hz, ret, state);
+	} else {
+		LOG_DBG("%s: %u Hz in %u us", radio->name, hz, us);
+	}
+}
+
+static void plan_thread(void *p1, void *p2, void *p3)
+{
+	/* End of the slots already accounted as unobserved. */
+	uint64_t unobserved_end = 0;
+
+	for (;;) {
+		uint64_t now = now_us();
+		uint64_t slot = now * SLOT_US_DEN / SLOT_US_NUM;
+		/* Cycles are counted from the start of a minute. */
+		uint32_t pos = (slot % SLOTS_PER_MINUTE) % cycle_slots;
+		uint32_t end = 0;
+		int index;
+
+		for (index = 0; index < plan_len; index++) {
+			end += plan[index].slots;
+			if (pos < end) {
+				break;
+			}
+		}
+
+		if (index != current) {
+			retune(index);
+		}
+
+		uint64_t next = slot - pos + end;
+
+		/* The last window of a cycle that does not fit a minute. */
+		if (next / SLOTS_PER_MINUTE != slot / SLOTS_PER_MINUTE) {
+			next = next - next % SLOTS_PER_MINUTE;
+		}
+
+#ifdef CONFIG_APP_CHANNEL_LOAD
+		if (plan[index].hz != home_hz && next > unobserved_end) {
+			uint64_t first = MAX(slot, unobserved_end);
+
+			channel_load_unobserved(radio_channel,
+				k_ticks_to_us_floor64(k_uptime_ticks()),
+				next - first);
+			unobserved_end = next;
+		}
+#endif
+
+		uint64_t next_us = ceiling_fraction(next * SLOT_US_NUM,
+						    SLOT_US_DEN);
+
+		now = now_us();
+		if (next_us > now) {
+			k_usleep(next_us - now);
+		}
+	}
+}
+
+int channel_plan_start(const struct device *dev, uint8_t channel)
+{
+	int ret = parse_plan(CONFIG_APP_CHANNEL_PLAN_WINDOWS);
+	if (ret < 0) {
+		LOG_ERR("Invalid channel plan \"%s\"",
+			CONFIG_APP_CHANNEL_PLAN_WINDOWS);
+		return ret;
+	}
+
+	radio = dev;
+	radio_channel = channel;
+	home_hz = AIS1_HZ + channel * AIS_CHANNEL_STEP_HZ;
+
+	LOG_INF("%s: %zu windows in %u slots", dev->name, plan_len,
+		cycle_slots);
+
+	k_thread_start(channel_plan);
+
+	return 0;
+}
+
+void channel_plan_pause(uint8_t channel)
+{
+	if (radio == NULL || channel != radio_channel) {
+		return;
+	}
+
+	k_mutex_lock(&radio_mutex, K_FOREVER);
+}
+
+void channel_plan_resume(uint8_t channel)
+{
+	if (radio == NULL || channel != radio_channel) {
+		return;
+	}
+
+	/* The configuration tuned the radio to its AIS channel. */
+	atomic_clear(&away);
+	current = -1;
+	k_mutex_unlock(&radio_mutex);
+
+	/* Retune for the current window instead of waiting for the next. */
+	k_wakeup(channel_plan);
+}
+
+bool channel_plan_away(uint8_t channel)
+{
+	return channel == radio_channel && atomic_get(&away);
+}
+
+void channel_plan_get_stats(struct channel_plan_stats *out)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	*out = stats;
+	k_spin_unlock(&lock, key);
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_plan(const struct shell *shell, size_t argc, char **argv)
+{
+	struct channel_plan_stats s;
+
+	if (radio == NULL) {
+		shell_print(shell, "not running");
+		return 0;
+	}
+
+	channel_plan_get_stats(&s);
+
+	for (int i = 0; i < plan_len; i++) {
+		shell_print(shell, "%c %9u Hz %4u slots",
+			    i == current ? '*' : ' ', plan[i].hz, plan[i].slots);
+	}
+
+	shell_print(shell, "retunes: %u, failures: %u", s.retunes, s.failures);
+	shell_print(shell, "retune: %u us, max %u us", s.last_retune_us,
+		    s.max_retune_us);
+
+	return 0;
+}
+
+SHELL_CMD_REGISTER(plan, NULL, "Show the channel plan", cmd_plan);
+#endif
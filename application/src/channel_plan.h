@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef APPLICATION_SRC_CHANNEL_PLAN_H_
+#define APPLICATION_SRC_CHANNEL_PLAN_H_
+
+#include <stdbool.h>
+#include <device.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct channel_plan_stats {
+	uint32_t retunes;
+	/** Retunes after which the radio did not get to RX in one slot. */
+	uint32_t failures;
+	/** Time from the start of a retune until the radio is in RX. */
+	uint32_t last_retune_us;
+	uint32_t max_retune_us;
+};
+
+/**
+ * Start moving the radio of a channel through the windows of
+ * CONFIG_APP_CHANNEL_PLAN_WINDOWS.
+ *
+ * The plan is a cycle of windows, each a frequency and a number of slots.
+ * Windows start on slot boundaries, of UTC when it is known and of the
+ * uptime otherwise, and the cycle is counted from the start of a UTC
+ * minute. Only with UTC does a retune at a window boundary fall between
+ * frames.
+ *
+ * @param dev Radio to retune.
+ * @param channel Channel index of the radio.
+ */
+int channel_plan_start(const struct device *dev, uint8_t channel);
+
+/**
+ * Keep the plan from retuning the radio of a channel, for example while
+ * it is configured again. Returns once a retune in progress is done.
+ */
+void channel_plan_pause(uint8_t channel);
+
+/**
+ * Let the plan retune the radio again. The radio is assumed to be on its
+ * AIS channel, it is retuned for the current window right away.
+ */
+void channel_plan_resume(uint8_t channel);
+
+/**
+ * Whether the radio of a channel is tuned away from its AIS channel.
+ * Frames received then are not on the channel of their index.
+ */
+bool channel_plan_away(uint8_t channel);
+
+void channel_plan_get_stats(struct channel_plan_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
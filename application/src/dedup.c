@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <shell/shell.h>
+
+#include "dedup.h"
+
+#define TABLE_SIZE CONFIG_APP_DEDUP_TABLE_SIZE
+#define TABLE_MASK (TABLE_SIZE - 1)
+/* Bounded linear probing keeps the lookup constant time. */
+#define MAX_PROBES 8
+
+BUILD_ASSERT((TABLE_SIZE & TABLE_MASK) == 0,
+	     "Dedup table size must be a power of two");
+
+/* Marks a used entry, FCS and length alone may be zero. */
+#define KEY_VALID BIT(24)
+
+struct dedup_entry {
+	uint32_t key;
+	uint32_t time_ms;
+};
+
+static struct dedup_entry table[TABLE_SIZE];
+static uint32_t suppressed[AIS_NUM_CHANNELS];
+
+static inline uint32_t hash(uint32_t key)
+{
+	/* Fibonacci hashing, FCS bits are already well distributed. */
+	return (key * 2654435761U) >> 16;
+}
+
+bool dedup_check(const struct ais_frame *frame)
+{
+	uint32_t key = KEY_VALID | (frame->len << 16) | frame->fcs;
+	uint32_t now = frame->time_us / USEC_PER_MSEC;
+	uint32_t idx = hash(key);
+	struct dedup_entry *free_entry = NULL;
+	struct dedup_entry *oldest = NULL;
+
+	for (int i = 0; i < MAX_PROBES; i++) {
+		struct dedup_entry *e = &table[(idx + i) & TABLE_MASK];
+		uint32_t age = now - e->time_ms;
+		bool expired = e->key == 0 ||
+			       age >= CONFIG_APP_DEDUP_WINDOW_MS;
+
+		if (!expired && e->key == key) {
+			suppressed[frame->channel]++;
+			return true;
+		}
+
+		if (expired) {
+			if (free_entry == NULL) {
+				free_entry = e;
+			}
+		} else if (oldest == NULL || age > now - oldest->time_ms) {
+			oldest = e;
+		}
+	}
+
+	if (free_entry == NULL) {
+		free_entry = oldest;
+	}
+
+	free_entry->key = key;
+	free_entry->time_ms = now;
+
+	return false;
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_dedup(const struct shell *shell, size_t argc, char **argv)
+{
+	shell_print(shell, "window: %u ms", CONFIG_APP_DEDUP_WINDOW_MS);
+
+	for (int i = 0; i < AIS_NUM_CHANNELS; i++) {
+		shell_print(shell, "ch %c suppressed: %u", 'A' + i,
+			    suppressed[i]);
+	}
+
+	return 0;
+}
+
+SHELL_CMD_REGISTER(dedup, NULL, "Show duplicate suppression statistics",
+		   cmd_dedup);
+#endif
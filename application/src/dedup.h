@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef APPLICATION_SRC_DEDUP_H_
+#define APPLICATION_SRC_DEDUP_H_
+
+#include <stdbool.h>
+#include "ais_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Check a frame against the recently seen frames.
+ *
+ * Frames are keyed on FCS and length, so copies received on the other
+ * channel or retransmitted by a repeater within CONFIG_APP_DEDUP_WINDOW_MS
+ * are detected. Constant time, the table has a fixed size.
+ *
+ * @return true if the frame is a duplicate and should be suppressed.
+ */
+bool dedup_check(const struct ais_frame *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
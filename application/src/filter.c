@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <stdlib.h>
+#include <shell/shell.h>
+
+#include "filter.h"
+
+#define MAX_MMSI CONFIG_APP_FILTER_MAX_MMSI
+#define ALL_TYPES UINT64_MAX
+#define ALL_CHANNELS BIT_MASK(AIS_NUM_CHANNELS)
+/* MMSIs have nine digits. */
+#define MAX_MMSI_VALUE 999999999
+
+struct filter_config {
+	/** Bit n set if message type n is allowed. */
+	uint64_t types;
+	/** Bit n set if channel n is allowed. */
+	uint8_t channels;
+	/** Number of entries in mmsi, allowlist is disabled if zero. */
+	uint16_t num_mmsi;
+	/** Sorted allowlist. */
+	uint32_t mmsi[MAX_MMSI];
+};
+
+static struct filter_config config = {
+	.types = ALL_TYPES,
+	.channels = ALL_CHANNELS,
+};
+
+static struct k_spinlock lock;
+static uint32_t rejected;
+
+static bool find_mmsi(uint32_t mmsi, int *pos)
+{
+	int lo = 0;
+	int hi = config.num_mmsi;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+
+		if (config.mmsi[mid] < mmsi) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	*pos = lo;
+
+	return lo < config.num_mmsi && config.mmsi[lo] == mmsi;
+}
+
+bool filter_accept(const struct ais_frame *frame)
+{
+	const uint8_t *data = frame->data;
+	bool accept = false;
+	int pos;
+
+	if (frame->len == 0) {
+		return false;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	if (!(config.channels & BIT(frame->channel))) {
+		goto out;
+	}
+
+	if (!(config.types & BIT64(ais_payload_type(data)))) {
+		goto out;
+	}
+
+	if (config.num_mmsi != 0) {
+		if (frame->len < 5 ||
+		    !find_mmsi(ais_payload_mmsi(data), &pos)) {
+			goto out;
+		}
+	}
+
+	accept = true;
+
+out:
+	if (!accept) {
+		rejected++;
+	}
+
+	k_spin_unlock(&lock, key);
+
+	return accept;
+}
+
+int filter_mmsi_add(uint32_t mmsi)
+{
+	int ret = 0;
+	int pos;
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	if (find_mmsi(mmsi, &pos)) {
+		goto out;
+	}
+
+	if (config.num_mmsi == MAX_MMSI) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	memmove(&config.mmsi[pos + 1], &config.mmsi[pos],
+		(config.num_mmsi - pos) * sizeof(config.mmsi[0]));
+	config.mmsi[pos] = mmsi;
+	config.num_mmsi++;
+
+out:
+	k_spin_unlock(&lock, key);
+	return ret;
+}
+
+int filter_mmsi_remove(uint32_t mmsi)
+{
+	int ret = 0;
+	int pos;
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	if (!find_mmsi(mmsi, &pos)) {
+		ret = -ENOENT;
+		goto out;
+	}
+
+	config.num_mmsi--;
+	memmove(&config.mmsi[pos], &config.mmsi[pos + 1],
+		(config.num_mmsi - pos) * sizeof(config.mmsi[0]));
+
+out:
+	k_spin_unlock(&lock, key);
+	return ret;
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_show(const struct shell *shell, size_t argc, char **argv)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct filter_config cfg = config;
+	uint32_t rej = rejected;
+	k_spin_unlock(&lock, key);
+
+	shell_fprintf(shell, SHELL_NORMAL, "types:");
+	if (cfg.types == ALL_TYPES) {
+		shell_fprintf(shell, SHELL_NORMAL, " all");
+	} else {
+		for (int i = 0; i < 64; i++) {
+			if (cfg.types & BIT64(i)) {
+				shell_fprintf(shell, SHELL_NORMAL, " %d", i);
+			}
+		}
+	}
+	shell_print(shell, "");
+
+	shell_print(shell, "channels: %s%s",
+		    (cfg.channels & BIT(0)) ? "A" : "",
+		    (cfg.channels & BIT(1)) ? "B" : "");
+
+	if (cfg.num_mmsi == 0) {
+		shell_print(shell, "mmsi: all");
+	} else {
+		for (int i = 0; i < cfg.num_mmsi; i++) {
+			shell_print(shell, "mmsi: %09u", cfg.mmsi[i]);
+		}
+	}
+
+	shell_print(shell, "rejected: %u", rej);
+
+	return 0;
+}
+
+/* A decimal number up to max, nothing else. */
+static int parse_number(const char *str, unsigned long max,
+			unsigned long *value)
+{
+	char *end;
+
+	*value = strtoul(str, &end, 10);
+	if (end == str || *end != '\0' || *value > max) {
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int parse_mmsi_args(const struct shell *shell, size_t argc,
+			   char **argv)
+{
+	unsigned long mmsi;
+
+	for (int i = 1; i < argc; i++) {
+		if (parse_number(argv[i], MAX_MMSI_VALUE, &mmsi) < 0) {
+			shell_error(shell, "invalid MMSI: %s", argv[i]);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static int cmd_types(const struct shell *shell, size_t argc, char **argv)
+{
+	uint64_t types = 0;
+
+	if (strcmp(argv[1], "all") == 0) {
+		types = ALL_TYPES;
+	} else {
+		for (int i = 1; i < argc; i++) {
+			unsigned long type;
+
+			if (parse_number(argv[i], 63, &type) < 0) {
+				shell_error(shell, "invalid type: %s", argv[i]);
+				return -EINVAL;
+			}
+
+			types |= BIT64(type);
+		}
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	config.types = types;
+	k_spin_unlock(&lock, key);
+
+	return 0;
+}
+
+static int cmd_channels(const struct shell *shell, size_t argc, char **argv)
+{
+	uint8_t channels = 0;
+
+	for (const char *p = argv[1]; *p; p++) {
+		if (*p == 'A' || *p == 'a') {
+			channels |= BIT(0);
+		} else if (*p == 'B' || *p == 'b') {
+			channels |= BIT(1);
+		} else {
+			shell_error(shell, "invalid channel: %c", *p);
+			return -EINVAL;
+		}
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	config.channels = channels;
+	k_spin_unlock(&lock, key);
+
+	return 0;
+}
+
+static int cmd_mmsi_add(const struct shell *shell, size_t argc, char **argv)
+{
+	/* Nothing is added unless all of them are valid. */
+	int ret = parse_mmsi_args(shell, argc, argv);
+	if (ret < 0) {
+		return ret;
+	}
+
+	for (int i = 1; i < argc; i++) {
+		ret = filter_mmsi_add(strtoul(argv[i], NULL, 10));
+
+		if (ret < 0) {
+			shell_error(shell, "allowlist is full");
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+static int cmd_mmsi_remove(const struct shell *shell, size_t argc,
+			   char **argv)
+{
+	int ret = parse_mmsi_args(shell, argc, argv);
+	if (ret < 0) {
+		return ret;
+	}
+
+	for (int i = 1; i < argc; i++) {
+		if (filter_mmsi_remove(strtoul(argv[i], NULL, 10)) < 0) {
+			shell_warn(shell, "not in allowlist: %s", argv[i]);
+		}
+	}
+
+	return 0;
+}
+
+static int cmd_mmsi_clear(const struct shell *shell, size_t argc,
+			  char **argv)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	config.num_mmsi = 0;
+	k_spin_unlock(&lock, key);
+
+	return 0;
+}
+
+static int cmd_reset(const struct shell *shell, size_t argc, char **argv)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	config.types = ALL_TYPES;
+	config.channels = ALL_CHANNELS;
+	config.num_mmsi = 0;
+	rejected = 0;
+	k_spin_unlock(&lock, key);
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_filter_mmsi,
+	SHELL_CMD_ARG(add, NULL, "Add MMSIs to the allowlist",
+		      cmd_mmsi_add, 2, 15),
+	SHELL_CMD_ARG(remove, NULL, "Remove MMSIs from the allowlist",
+		      cmd_mmsi_remove, 2, 15),
+	SHELL_CMD(clear, NULL, "Clear the allowlist, allow all MMSIs",
+		  cmd_mmsi_clear),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_filter,
+	SHELL_CMD(show, NULL, "Show the filter", cmd_show),
+	SHELL_CMD_ARG(types, NULL, "Allowed message types: all | <type>...",
+		      cmd_types, 2, 15),
+	SHELL_CMD_ARG(channels, NULL, "Allowed channels: A | B | AB",
+		      cmd_channels, 2, 0),
+	SHELL_CMD(mmsi, &sub_filter_mmsi, "MMSI allowlist", NULL),
+	SHELL_CMD(reset, NULL, "Forward everything", cmd_reset),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(filter, &sub_filter, "Message filter", NULL);
+#endif
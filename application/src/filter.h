@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef APPLICATION_SRC_FILTER_H_
+#define APPLICATION_SRC_FILTER_H_
+
+#include <stdbool.h>
+#include "ais_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Message type, the first six payload bits. */
+static inline uint8_t ais_payload_type(const uint8_t *data)
+{
+	return data[0] >> 2;
+}
+
+/** Source MMSI, payload bits 8 to 37. Needs at least 5 bytes. */
+static inline uint32_t ais_payload_mmsi(const uint8_t *data)
+{
+	return ((uint32_t)data[1] << 22) | ((uint32_t)data[2] << 14) |
+	       ((uint32_t)data[3] << 6) | (data[4] >> 2);
+}
+
+/**
+ * Check a frame against the runtime filter.
+ *
+ * The filter is configured with the "filter" shell command: allowed
+ * message types, allowed channels and an optional MMSI allowlist.
+ *
+ * @return true if the frame should be forwarded.
+ */
+bool filter_accept(const struct ais_frame *frame);
+
+/** Add an MMSI to the allowlist. */
+int filter_mmsi_add(uint32_t mmsi);
+/** Remove an MMSI from the allowlist. */
+int filter_mmsi_remove(uint32_t mmsi);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,489 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <drivers/flash.h>
+#include <storage/flash_map.h>
+#include <sys/byteorder.h>
+#include <sys/crc.h>
+#include <shell/shell.h>
+
+#include "ais_binary.h"
+#include "capture.h"
+#include "flash_log.h"
+#include "streams.h"
+#ifdef CONFIG_APP_TIME
+#include "ais_time.h"
+#endif
+
+#define LOG_LEVEL CONFIG_LOG_DEFAULT_LEVEL
+#include <logging/log.h>
+LOG_MODULE_REGISTER(flash_log);
+
+/* Erase unit of the STM32L4 internal flash. */
+#define PAGE_SIZE 2048
+#define PAGE_MAGIC 0x474c4941
+#define PAGE_VERSION 1
+#define FLUSH_TIME_MS (CONFIG_APP_FLASH_LOG_FLUSH_TIME * MSEC_PER_SEC)
+
+#define RECORD_VALID BIT(7)
+#define RECORD_AWAY BIT(2)
+#define RECORD_QUALITY BIT(1)
+#define RECORD_CHANNEL BIT(0)
+/* Header, length, quality, 64 bit varint and the longest payload. */
+#define RECORD_MAX_SIZE (3 + 10 + UINT8_MAX)
+
+#define DUMP_CHUNK_SIZE 256
+#define DUMP_HEADER_SIZE 6
+#define DUMP_RAW_SIZE (DUMP_HEADER_SIZE + DUMP_CHUNK_SIZE + 2)
+#define DUMP_END_OFFSET 0xffff
+#define DUMP_TIMEOUT K_SECONDS(1)
+
+struct page_header {
+	uint32_t magic;
+	uint32_t seq;
+	uint64_t base_ms;
+	uint16_t used;
+	uint8_t version;
+	uint8_t flags;
+	uint32_t reserved;
+};
+
+BUILD_ASSERT(sizeof(struct page_header) == 24, "Unexpected header layout");
+BUILD_ASSERT(PAGE_SIZE % DUMP_CHUNK_SIZE == 0, "Chunks must fill a page");
+
+static const struct flash_area *area;
+static size_t num_pages;
+static K_MUTEX_DEFINE(lock);
+
+/* Page being filled in RAM, programmed to flash page next_page. */
+static uint8_t page[PAGE_SIZE] __aligned(8);
+static struct page_header *const header = (struct page_header *)page;
+static size_t next_page;
+static uint32_t next_seq;
+static uint64_t last_ms;
+static int64_t opened_at;
+
+static uint32_t records;
+static uint32_t pages_written;
+static uint32_t write_errors;
+
+static inline bool page_open(void)
+{
+	return header->magic == PAGE_MAGIC;
+}
+
+static inline off_t page_offset(size_t index)
+{
+	return (off_t)index * PAGE_SIZE;
+}
+
+static bool read_header(size_t index, struct page_header *hdr)
+{
+	if (flash_area_read(area, page_offset(index), hdr, sizeof(*hdr)) < 0) {
+		return false;
+	}
+
+	return hdr->magic == PAGE_MAGIC && hdr->version == PAGE_VERSION &&
+	       hdr->used >= sizeof(*hdr) && hdr->used <= PAGE_SIZE;
+}
+
+/*
+ * Program the buffered page. The header goes last, so a page interrupted
+ * by a reset is not recognized on the next mount.
+ */
+static void write_page(void)
+{
+	off_t off = page_offset(next_page);
+	size_t len = ROUND_UP(header->used, 8);
+	int ret;
+
+	memset(page + header->used, 0xff, len - header->used);
+
+	ret = flash_area_erase(area, off, PAGE_SIZE);
+	if (ret == 0 && len > sizeof(*header)) {
+		ret = flash_area_write(area, off + sizeof(*header),
+				       page + sizeof(*header),
+				       len - sizeof(*header));
+	}
+	if (ret == 0) {
+		ret = flash_area_write(area, off, header, sizeof(*header));
+	}
+
+	if (ret < 0) {
+		LOG_ERR("Failed to write page %u: %d", next_page, ret);
+		write_errors++;
+	} else {
+		pages_written++;
+	}
+
+	next_page = (next_page + 1) % num_pages;
+	header->magic = 0;
+}
+
+static void open_page(uint64_t base_ms, uint8_t flags)
+{
+	memset(page, 0xff, sizeof(*header));
+	header->magic = PAGE_MAGIC;
+	header->seq = next_seq++;
+	header->base_ms = base_ms;
+	header->used = sizeof(*header);
+	header->version = PAGE_VERSION;
+	header->flags = flags;
+
+	last_ms = base_ms;
+	opened_at = k_uptime_get();
+}
+
+static uint8_t frame_time(const struct ais_frame *frame, uint64_t *ms)
+{
+#ifdef CONFIG_APP_TIME
+	uint64_t utc_us;
+
+	if (ais_time_from_local(frame->time_us, &utc_us) == 0) {
+		*ms = utc_us / USEC_PER_MSEC;
+		return FLASH_LOG_PAGE_UTC;
+	}
+#endif
+
+	*ms = frame->time_us / USEC_PER_MSEC;
+	return 0;
+}
+
+static uint8_t *put_varint(uint8_t *p, int64_t value)
+{
+	uint64_t v = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+
+	while (v >= 0x80) {
+		*p++ = (v & 0x7f) | 0x80;
+		v >>= 7;
+	}
+	*p++ = v;
+
+	return p;
+}
+
+int flash_log_init(void)
+{
+	struct page_header hdr;
+	bool found = false;
+	uint32_t head_seq = 0;
+	size_t head = 0;
+
+	int ret = flash_area_open(FLASH_AREA_ID(frame_log), &area);
+	if (ret < 0) {
+		return ret;
+	}
+
+	num_pages = area->fa_size / PAGE_SIZE;
+	if (num_pages < 2) {
+		return -EINVAL;
+	}
+
+	for (size_t i = 0; i < num_pages; i++) {
+		if (!read_header(i, &hdr)) {
+			continue;
+		}
+
+		if (!found || (int32_t)(hdr.seq - head_seq) > 0) {
+			head = i;
+			head_seq = hdr.seq;
+			found = true;
+		}
+	}
+
+	if (found) {
+		next_page = (head + 1) % num_pages;
+		next_seq = head_seq + 1;
+	}
+
+	LOG_INF("%u pages, next %u, seq %u", num_pages, next_page, next_seq);
+
+	return 0;
+}
+
+void flash_log_append(const struct ais_frame *frame)
+{
+	uint64_t ms;
+	uint8_t flags;
+
+	if (area == NULL) {
+		return;
+	}
+
+	flags = frame_time(frame, &ms);
+
+	k_mutex_lock(&lock, K_FOREVER);
+
+	/* A page uses one time base, start a new one when UTC comes or goes. */
+	if (page_open() && (header->flags != flags ||
+			    PAGE_SIZE - header->used < RECORD_MAX_SIZE)) {
+		write_page();
+	}
+
+	if (!page_open()) {
+		open_page(ms, flags);
+	}
+
+	uint8_t *start = page + header->used;
+	uint8_t *p = start;
+
+	*p++ = RECORD_VALID | (frame->channel & RECORD_CHANNEL) |
+	       ((frame->flags & AIS_FRAME_HAS_QUALITY) ? RECORD_QUALITY : 0) |
+	       ((frame->flags & AIS_FRAME_AWAY) ? RECORD_AWAY : 0);
+	*p++ = frame->len;
+	if (frame->flags & AIS_FRAME_HAS_QUALITY) {
+		*p++ = frame->quality;
+	}
+	/* Frames of the two channels may arrive slightly out of order. */
+	p = put_varint(p, (int64_t)(ms - last_ms));
+	memcpy(p, frame->data, frame->len);
+	p += frame->len;
+
+	header->used += p - start;
+	last_ms = ms;
+	records++;
+
+	k_mutex_unlock(&lock);
+}
+
+void flash_log_poll(void)
+{
+	k_mutex_lock(&lock, K_FOREVER);
+
+	if (page_open() && k_uptime_get() - opened_at >= FLUSH_TIME_MS) {
+		write_page();
+	}
+
+	k_mutex_unlock(&lock);
+}
+
+#ifdef CONFIG_SHELL
+static uint8_t dump_raw[DUMP_RAW_SIZE];
+static uint8_t dump_encoded[DUMP_RAW_SIZE + DUMP_RAW_SIZE / 254 + 2];
+
+static int send_chunk(uint32_t seq, uint16_t offset, size_t len)
+{
+	uint8_t *p = dump_raw;
+
+	sys_put_le32(seq, p);
+	sys_put_le16(offset, p + 4);
+	p += DUMP_HEADER_SIZE + len;
+	sys_put_le16(crc16_ccitt(0xffff, dump_raw, p - dump_raw), p);
+	p += 2;
+
+	size_t out_len = cobs_encode(dump_raw, p - dump_raw, dump_encoded);
+	dump_encoded[out_len++] = 0;
+
+	return stream_write(STREAM_LOG, dump_encoded, out_len, DUMP_TIMEOUT);
+}
+
+/*
+ * Read a chunk of a flash page, unless the page was overwritten since its
+ * header was read.
+ */
+static int read_chunk(size_t index, uint32_t seq, uint16_t offset,
+		      uint8_t *data, size_t len)
+{
+	struct page_header hdr;
+	int ret = -ESTALE;
+
+	k_mutex_lock(&lock, K_FOREVER);
+
+	if (read_header(index, &hdr) && hdr.seq == seq) {
+		ret = flash_area_read(area, page_offset(index) + offset, data,
+				      len);
+	}
+
+	k_mutex_unlock(&lock);
+
+	return ret;
+}
+
+static int dump_flash_page(size_t index, size_t *bytes)
+{
+	uint8_t *data = dump_raw + DUMP_HEADER_SIZE;
+	struct page_header hdr;
+
+	k_mutex_lock(&lock, K_FOREVER);
+	bool valid = read_header(index, &hdr);
+	k_mutex_unlock(&lock);
+
+	if (!valid) {
+		return 0;
+	}
+
+	for (uint16_t off = 0; off < hdr.used; off += DUMP_CHUNK_SIZE) {
+		size_t len = MIN(DUMP_CHUNK_SIZE, hdr.used - off);
+
+		if (read_chunk(index, hdr.seq, off, data, len) < 0) {
+			/* Overwritten by the log, the page is gone anyway. */
+			return 0;
+		}
+
+		int ret = send_chunk(hdr.seq, off, len);
+		if (ret < 0) {
+			return ret;
+		}
+
+		*bytes += ret;
+	}
+
+	return 0;
+}
+
+static int dump_ram_page(size_t *bytes)
+{
+	uint8_t *data = dump_raw + DUMP_HEADER_SIZE;
+
+	for (uint16_t off = 0;; off += DUMP_CHUNK_SIZE) {
+		uint32_t seq = 0;
+		size_t len = 0;
+
+		k_mutex_lock(&lock, K_FOREVER);
+		bool done = !page_open() || off >= header->used;
+		if (!done) {
+			seq = header->seq;
+			len = MIN(DUMP_CHUNK_SIZE, header->used - off);
+			memcpy(data, page + off, len);
+		}
+		k_mutex_unlock(&lock);
+
+		if (done) {
+			return 0;
+		}
+
+		int ret = send_chunk(seq, off, len);
+		if (ret < 0) {
+			return ret;
+		}
+
+		*bytes += ret;
+	}
+}
+
+static int cmd_flog_dump(const struct shell *shell, size_t argc, char **argv)
+{
+	int64_t start = k_uptime_get();
+	size_t bytes = 0;
+	int ret = 0;
+
+	if (area == NULL) {
+		shell_error(shell, "log not mounted");
+		return -ENODEV;
+	}
+
+#ifdef CONFIG_APP_CAPTURE
+	/* The chunks would be mixed into the capture byte stream. */
+	if (strcmp(CONFIG_APP_FLASH_LOG_PORT, CONFIG_APP_CAPTURE_PORT) == 0 &&
+	    capture_get_mode() != CAPTURE_OFF) {
+		shell_error(shell, "capture is running on %s, stop it first",
+			    CONFIG_APP_CAPTURE_PORT);
+		return -EBUSY;
+	}
+#endif
+
+	/* Oldest first: the page after the last written one. */
+	for (size_t i = 0; i < num_pages && ret == 0; i++) {
+		ret = dump_flash_page((next_page + i) % num_pages, &bytes);
+	}
+
+	if (ret == 0) {
+		ret = dump_ram_page(&bytes);
+	}
+
+	if (ret == 0) {
+		ret = send_chunk(0, DUMP_END_OFFSET, 0);
+	}
+
+	if (ret < 0) {
+		shell_error(shell, "dump aborted: %d", ret);
+		return ret;
+	}
+
+	int64_t elapsed = MAX(k_uptime_get() - start, 1);
+
+	shell_print(shell, "%u bytes in %u ms, %u kB/s", bytes,
+		    (uint32_t)elapsed, (uint32_t)(bytes / elapsed));
+
+	return 0;
+}
+
+static int cmd_flog_flush(const struct shell *shell, size_t argc, char **argv)
+{
+	if (area == NULL) {
+		shell_error(shell, "log not mounted");
+		return -ENODEV;
+	}
+
+	k_mutex_lock(&lock, K_FOREVER);
+	if (page_open()) {
+		write_page();
+	}
+	k_mutex_unlock(&lock);
+
+	return 0;
+}
+
+static int cmd_flog_erase(const struct shell *shell, size_t argc, char **argv)
+{
+	if (area == NULL) {
+		shell_error(shell, "log not mounted");
+		return -ENODEV;
+	}
+
+	k_mutex_lock(&lock, K_FOREVER);
+	int ret = flash_area_erase(area, 0, num_pages * PAGE_SIZE);
+	header->magic = 0;
+	next_page = 0;
+	next_seq = 0;
+	k_mutex_unlock(&lock);
+
+	if (ret < 0) {
+		shell_error(shell, "erase failed: %d", ret);
+	}
+
+	return ret;
+}
+
+static int cmd_flog(const struct shell *shell, size_t argc, char **argv)
+{
+	struct page_header hdr;
+	size_t used = 0;
+
+	if (area == NULL) {
+		shell_error(shell, "log not mounted");
+		return -ENODEV;
+	}
+
+	k_mutex_lock(&lock, K_FOREVER);
+	for (size_t i = 0; i < num_pages; i++) {
+		if (read_header(i, &hdr)) {
+			used++;
+		}
+	}
+	size_t buffered = page_open() ? header->used : 0;
+	k_mutex_unlock(&lock);
+
+	shell_print(shell, "pages: %u/%u, next: %u, seq: %u", used, num_pages,
+		    next_page, next_seq);
+	shell_print(shell, "buffered: %u/%u bytes", buffered, PAGE_SIZE);
+	shell_print(shell, "records: %u, pages written: %u, errors: %u",
+		    records, pages_written, write_errors);
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_flog,
+	SHELL_CMD(dump, NULL, "Send the log to the log port", cmd_flog_dump),
+	SHELL_CMD(flush, NULL, "Write the buffered page", cmd_flog_flush),
+	SHELL_CMD(erase, NULL, "Erase the log", cmd_flog_erase),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(flog, &sub_flog, "Frame log statistics", cmd_flog);
+#endif
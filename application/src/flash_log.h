@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef APPLICATION_SRC_FLASH_LOG_H_
+#define APPLICATION_SRC_FLASH_LOG_H_
+
+#include "ais_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Store-and-forward log of decoded frames in the "frame_log" flash
+ * partition.
+ *
+ * The partition is used as a ring of flash pages. Records are collected
+ * in a RAM page buffer and every page is erased and programmed once, when
+ * it is full or when its oldest record is CONFIG_APP_FLASH_LOG_FLUSH_TIME
+ * seconds old. Pages are written in sequence, so every page is erased
+ * once per pass over the ring and the oldest page is overwritten first.
+ *
+ * Page layout, all fields little endian:
+ *
+ *   u32 magic, u32 sequence number, u64 time of the first record in ms,
+ *   u16 bytes used including this header, u8 version, u8 flags,
+ *   u32 reserved
+ *   records until the used size:
+ *     u8 header: bit 7 set, bit 2 received away from the channel (see
+ *       AIS_FRAME_AWAY), bit 1 quality follows, bit 0 channel
+ *     u8 payload length
+ *     [i8 quality]
+ *     zigzag varint: time in ms relative to the previous record
+ *     payload
+ *
+ * Times are in ms since boot, or since the UNIX epoch when the page has
+ * FLASH_LOG_PAGE_UTC set.
+ *
+ * The "flog dump" shell command sends the pages, oldest first, to the log
+ * port as COBS encoded, zero delimited chunks:
+ *
+ *   u32 page sequence number, u16 offset in page, data, u16 CRC-16/CCITT
+ *
+ * Only the used part of every page is sent, including the page that is
+ * still buffered in RAM. The dump ends with a chunk at offset 0xffff
+ * without data. scripts/flash_log.py decodes the dump.
+ */
+
+#define FLASH_LOG_PAGE_UTC BIT(0)
+
+/** Mount the log partition, must be called before any other function. */
+int flash_log_init(void);
+
+/** Append a frame to the log. */
+void flash_log_append(const struct ais_frame *frame);
+
+/** Write the buffered page if it is due, call periodically. */
+void flash_log_poll(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <stdio.h>
+#include <settings/settings.h>
+#include <sys/crc.h>
+
+#include "ircal_cache.h"
+#include "si4362.h"
+
+#define LOG_LEVEL CONFIG_LOG_DEFAULT_LEVEL
+#include <logging/log.h>
+LOG_MODULE_REGISTER(ircal_cache);
+
+#define TEMP_BAND CONFIG_APP_IRCAL_TEMP_BAND
+/* Bands are counted from the lowest operating temperature. */
+#define TEMP_MIN (-40)
+
+/*
+ * IRCAL_AMP_SKIP and IRCAL_PH_SKIP of IRCAL_MANUAL (0x19) in the Si446x
+ * API documentation, SI446X_CMD_IRCAL_MANUAL_ARG_IRCAL_*_SKIP_MASK in the
+ * si446x_cmd.h header of the Silicon Labs API. With the bit set the value
+ * is left alone, so both bits set only read back the calibration. With
+ * the bit clear the value in the low bits is applied.
+ */
+#define IRCAL_MANUAL_SKIP BIT(7)
+/* Entries written with the skip bit taken for an apply bit are dropped. */
+#define ENTRY_VERSION 1
+
+struct ircal_entry {
+	uint32_t config_crc;
+	uint16_t part;
+	uint16_t id;
+	uint8_t chip_rev;
+	uint8_t rom_id;
+	int8_t temp_band;
+	uint8_t version;
+	uint8_t amp;
+	uint8_t ph;
+};
+
+struct load_ctx {
+	struct ircal_entry *entry;
+	bool found;
+};
+
+/* CRC of the commands as sent, whether stored as a delta or not. */
+static uint32_t stream_crc(const struct si4362_stream *stream)
+{
+	struct si4362_stream_iter iter;
+	const uint8_t *cmd;
+	uint32_t crc = 0;
+
+	si4362_stream_iter_init(&iter, stream);
+
+	while ((cmd = si4362_stream_next(&iter)) != NULL) {
+		crc = crc32_ieee_update(crc, cmd, cmd[0] + 1);
+	}
+
+	return crc;
+}
+
+/* Fill the tags of an entry from the radio as it is now. */
+static int get_tags(const struct device *dev,
+		    const struct si4362_stream *cal_stream,
+		    struct ircal_entry *entry)
+{
+	struct si4362_part_info info;
+	int celsius;
+
+	int ret = si4362_part_info(dev, &info);
+	if (ret < 0) {
+		return ret;
+	}
+
+	ret = si4362_get_temperature(dev, &celsius);
+	if (ret < 0) {
+		return ret;
+	}
+
+	memset(entry, 0, sizeof(*entry));
+	entry->version = ENTRY_VERSION;
+	entry->config_crc = stream_crc(cal_stream);
+	entry->part = info.part;
+	entry->id = info.id;
+	entry->chip_rev = info.chip_rev;
+	entry->rom_id = info.rom_id;
+	entry->temp_band = (MAX(celsius, TEMP_MIN) - TEMP_MIN) / TEMP_BAND;
+
+	LOG_DBG("%s: part %04x, %d C", dev->name, info.part, celsius);
+
+	return 0;
+}
+
+static bool tags_match(const struct ircal_entry *a, const struct ircal_entry *b)
+{
+	return a->version == b->version &&
+	       a->config_crc == b->config_crc && a->part == b->part &&
+	       a->id == b->id && a->chip_rev == b->chip_rev &&
+	       a->rom_id == b->rom_id && a->temp_band == b->temp_band;
+}
+
+static void make_key(char *key, size_t size, uint8_t index)
+{
+	snprintf(key, size, "ircal/%u", index);
+}
+
+static int load_cb(const char *key, size_t len, settings_read_cb read_cb,
+		   void *cb_arg, void *param)
+{
+	struct load_ctx *ctx = param;
+
+	if (len != sizeof(*ctx->entry)) {
+		return 0;
+	}
+
+	if (read_cb(cb_arg, ctx->entry, len) == len) {
+		ctx->found = true;
+	}
+
+	return 0;
+}
+
+int ircal_cache_init(void)
+{
+	return settings_subsys_init();
+}
+
+int ircal_cache_restore(const struct device *dev, uint8_t index,
+			const struct si4362_stream *cal_stream)
+{
+	struct ircal_entry current;
+	struct ircal_entry stored;
+	struct load_ctx ctx = {
+		.entry = &stored,
+	};
+	uint8_t reply[2];
+	char key[16];
+
+	int ret = get_tags(dev, cal_stream, &current);
+	if (ret < 0) {
+		return ret;
+	}
+
+	make_key(key, sizeof(key), index);
+	settings_load_subtree_direct(key, load_cb, &ctx);
+
+	if (!ctx.found || !tags_match(&current, &stored)) {
+		LOG_INF("%s: no calibration for this radio and temperature",
+			dev->name);
+		return -ENOENT;
+	}
+
+	ret = si4362_ircal_manual(dev, stored.amp & ~IRCAL_MANUAL_SKIP,
+				  stored.ph & ~IRCAL_MANUAL_SKIP, reply);
+	if (ret < 0) {
+		return ret;
+	}
+
+	LOG_INF("%s: calibration restored", dev->name);
+
+	return 0;
+}
+
+int ircal_cache_store(const struct device *dev, uint8_t index,
+		      const struct si4362_stream *cal_stream)
+{
+	struct ircal_entry entry;
+	uint8_t reply[2];
+	char key[16];
+
+	int ret = get_tags(dev, cal_stream, &entry);
+	if (ret < 0) {
+		return ret;
+	}
+
+	ret = si4362_ircal_manual(dev, IRCAL_MANUAL_SKIP, IRCAL_MANUAL_SKIP,
+				  reply);
+	if (ret < 0) {
+		return ret;
+	}
+
+	entry.amp = reply[0] & ~IRCAL_MANUAL_SKIP;
+	entry.ph = reply[1] & ~IRCAL_MANUAL_SKIP;
+
+	make_key(key, sizeof(key), index);
+	ret = settings_save_one(key, &entry, sizeof(entry));
+	if (ret < 0) {
+		LOG_ERR("%s: failed to store calibration: %d", dev->name, ret);
+		return ret;
+	}
+
+	LOG_INF("%s: calibration stored, amp 0x%02x, ph 0x%02x", dev->name,
+		entry.amp, entry.ph);
+
+	return 0;
+}
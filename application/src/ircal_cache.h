@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef APPLICATION_SRC_IRCAL_CACHE_H_
+#define APPLICATION_SRC_IRCAL_CACHE_H_
+
+#include <device.h>
+
+#include "si4362.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Cache of image rejection calibration results.
+ *
+ * Results are stored with the settings subsystem, one entry per radio,
+ * tagged with the radio part info, a CRC of the calibration stream and
+ * the temperature band the calibration ran in. An entry is only used when
+ * all tags match.
+ */
+int ircal_cache_init(void);
+
+/**
+ * Apply cached calibration values to a configured radio.
+ *
+ * @param index Radio index, the settings key.
+ * @param cal_stream Init commands that calibrate the radio.
+ *
+ * @return 0 on success, -ENOENT if the radio must be calibrated.
+ */
+int ircal_cache_restore(const struct device *dev, uint8_t index,
+			const struct si4362_stream *cal_stream);
+
+/** Read back and store the results of a calibration just done. */
+int ircal_cache_store(const struct device *dev, uint8_t index,
+		      const struct si4362_stream *cal_stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -7,27 +7,47 @@
 #include <zephyr.h>
 #include <kernel.h>
 #include <usb/usb_device.h>
-#include <stdio.h>
-#include <console/tty.h>
 
 #include "hdlc.h"
 #include "si4362.h"
 #include "radio_configs.h"
+#include "ais_frame.h"
+#include "ais_time.h"
+#include "capture.h"
+#include "channel_load.h"
+#include "channel_plan.h"
+#include "dedup.h"
+#include "filter.h"
+#include "ircal_cache.h"
+#include "output.h"
+#include "radio_monitor.h"
+#include "reduce.h"
+#include "sinks.h"
+#include "streams.h"
 
 #define LOG_LEVEL CONFIG_LOG_DEFAULT_LEVEL
 #include <logging/log.h>
 LOG_MODULE_REGISTER(app);
 
-#define AIS_NUM_CHANNELS 2
 #define AIS_QUEUE_LENGTH 16
 
-K_MSGQ_DEFINE(ais_msgq, 1, AIS_QUEUE_LENGTH, 1);
+/*
+ * Queue entries carry the received bit, the channel index and the cycle
+ * counter value at the time the bit was sampled. The lowest two bits of the
+ * cycle counter are sacrificed to store the bit and the channel.
+ */
+#define AIS_MSG_BIT BIT(0)
+#define AIS_MSG_CHANNEL_SHIFT 1
+#define AIS_MSG_CYCLES_MASK (~0x3U)
+
+K_MSGQ_DEFINE(ais_msgq, sizeof(uint32_t), AIS_QUEUE_LENGTH, 4);
 
 #define DEF_AIS_CALLBACK(name, index)						\
 static void name(const struct device *dev, int raw_bit)				\
 {										\
 	__ASSERT_NO_MSG(raw_bit >= 0);						\
-	uint8_t msg = (index << 1) | (raw_bit & 1);				\
+	uint32_t msg = (k_cycle_get_32() & AIS_MSG_CYCLES_MASK) |		\
+		       (index << AIS_MSG_CHANNEL_SHIFT) | (raw_bit & 1);	\
 	int ret = k_msgq_put(&ais_msgq, &msg, K_NO_WAIT);			\
 	if (ret != 0) {								\
 		LOG_ERR("Failed to put message: %d", ret);			\
@@ -39,7 +59,11 @@ DEF_AIS_CALLBACK(ch2_callback, 1)
 
 struct ais_config {
 	const char *dev_name;
-	const uint8_t *config_data;
+	struct si4362_stream config_data;
+#ifdef CONFIG_APP_IRCAL_CACHE
+	struct si4362_stream warm_data;
+	struct si4362_stream ircal_data;
+#endif
 	si4362_rx_callback callback;
 };
 
@@ -47,125 +71,366 @@ struct ais_state {
 	const struct device *dev;
 	struct hdlc_data hdlc;
 	uint8_t channel_index;
+	/** Cycle counter value of the last bit fed to the decoder. */
+	uint32_t bit_cycles;
+#ifdef CONFIG_APP_RSSI
+	/* Reads the RSSI when a frame starts. */
+	struct k_work rssi_work;
+	/** RSSI of the current frame with RSSI_VALID, 0 if not read yet. */
+	atomic_t rssi;
+#endif
 };
 
-#define NMEA_MAX_LENGTH 82
-#define AIVDM_OVERHEAD (strlen("!AIVDM,0,0,0,A,,0,*00\r\n"))
-// Note: this is the limit for multipart messages, it is one greater for single
-// part.
-#define MAX_SENTENCE_CHARS (NMEA_MAX_LENGTH - AIVDM_OVERHEAD)
-
-static char nmea_buffer[NMEA_MAX_LENGTH + 1];
-static uint8_t multipart_counter;
+#define RSSI_VALID BIT(8)
 
-static struct tty_serial tty;
-
-static char get_ascii6(const uint8_t *buf, uint16_t bit_offset)
+/* Convert a recently captured cycle counter value to microseconds since boot. */
+static uint64_t cycles_to_time_us(uint32_t cycles)
 {
-	uint16_t byte_idx = bit_offset / 8;
-	uint16_t bit_idx = bit_offset % 8;
-	uint8_t n;
-
-	if (bit_idx <= 2) {
-		n = (buf[byte_idx] >> (2 - bit_idx)) & 0x3f;
-	} else {
-		n = ((buf[byte_idx] << (bit_idx - 2)) & 0x3f)
-		  | (buf[byte_idx + 1] >> (10 - bit_idx));
-	}
-
-	__ASSERT_NO_MSG(n < 64);
+	uint32_t age = (k_cycle_get_32() - cycles) & AIS_MSG_CYCLES_MASK;
+	uint64_t now_us = k_ticks_to_us_floor64(k_uptime_ticks());
+	uint64_t age_us = k_cyc_to_us_floor64(age);
 
-	return (n >= 40) ? n + 56 : n + 48;
+	return now_us > age_us ? now_us - age_us : 0;
 }
 
-static void hdlc_callback(const struct hdlc_data *hdlc, const uint8_t *buf, size_t len)
+#ifdef CONFIG_APP_CHANNEL_LOAD
+static void hdlc_error_callback(const struct hdlc_data *hdlc, size_t num_bits)
 {
 	const struct ais_state *ais = CONTAINER_OF(hdlc, struct ais_state, hdlc);
-	uint16_t num_chars = ceiling_fraction(len * 8, 6);
-
-	bool multipart = num_chars > MAX_SENTENCE_CHARS + 1;
-	uint8_t num_parts = multipart ?
-		ceiling_fraction(num_chars, MAX_SENTENCE_CHARS) : 1;
-	LOG_DBG("len: %zu, chars: %u, parts: %u", len, num_chars, num_parts);
-
-	char channel = 'A' + ais->channel_index;
-	uint16_t bit_offset = 0;
-	uint16_t remaining_chars = num_chars;
-
-	for (uint8_t part = 1; part <= num_parts; part++) {
-		char *p = nmea_buffer;
-
-		/* Put header. */
-		if (multipart) {
-			p += sprintf(p, "!AIVDM,%u,%u,%u,%c,", num_parts, part,
-				     multipart_counter, channel);
-		} else {
-			p += sprintf(p, "!AIVDM,1,1,,%c,", channel);
-		}
 
-		/* Put the data. */
-		uint16_t part_chars = remaining_chars;
-		if (multipart && remaining_chars > MAX_SENTENCE_CHARS) {
-			part_chars = MAX_SENTENCE_CHARS;
-		}
+#ifdef CONFIG_APP_CHANNEL_PLAN
+	/* Not a collision on the channel of the radio. */
+	if (channel_plan_away(ais->channel_index)) {
+		return;
+	}
+#endif
 
-		LOG_DBG("part: %u, chars: %u", part, part_chars);
+	channel_load_update(ais->channel_index,
+			    cycles_to_time_us(ais->bit_cycles), num_bits, false);
+}
+#endif
 
-		for (int i = 0; i < part_chars; i++) {
-			*p++ = get_ascii6(buf, bit_offset);
-			bit_offset += 6;
-		}
+#ifdef CONFIG_APP_RSSI
+/*
+ * Runs in the system work queue, so the SPI transaction never holds up
+ * the decoder thread. The WDS configuration leaves RSSI latching disabled
+ * in RX (MODEM_RSSI_CONTROL is 0x00 before the final START_RX), and the
+ * radio stays in RX in direct mode, so the current RSSI is read instead,
+ * early in the frame.
+ */
+static void rssi_work_handler(struct k_work *work)
+{
+	struct ais_state *ais = CONTAINER_OF(work, struct ais_state, rssi_work);
+	uint8_t rssi;
 
-		remaining_chars -= part_chars;
+	if (si4362_get_rssi(ais->dev, &rssi) == 0) {
+		atomic_set(&ais->rssi, RSSI_VALID | rssi);
+	}
+}
 
-		/* Add pad info */
-		uint8_t pad = 0;
+static void rssi_frame_start(struct ais_state *ais)
+{
+	atomic_clear(&ais->rssi);
+	k_work_submit(&ais->rssi_work);
+}
 
-		if (part == num_parts) {
-			__ASSERT_NO_MSG(num_chars * 6 >= len * 8);
-			pad = num_chars * 6 - len * 8;
-		}
+static void rssi_init(struct ais_state *ais)
+{
+	k_work_init(&ais->rssi_work, rssi_work_handler);
+}
+#endif
 
-		p += sprintf(p, ",%u", pad);
+static void hdlc_callback(const struct hdlc_data *hdlc, const uint8_t *buf, size_t len)
+{
+	struct ais_state *ais = CONTAINER_OF(hdlc, struct ais_state, hdlc);
+	struct ais_frame frame = {
+		.time_us = cycles_to_time_us(ais->bit_cycles),
+		.data = buf,
+		.fcs = hdlc->fcs,
+		.len = len,
+		.stuffed_bits = hdlc->num_stuffed,
+		.channel = ais->channel_index,
+	};
+
+#ifdef CONFIG_APP_RSSI
+	atomic_val_t rssi = atomic_clear(&ais->rssi);
+
+	if (rssi & RSSI_VALID) {
+		int dbm = (uint8_t)rssi / 2 - CONFIG_APP_RSSI_OFFSET;
+
+		frame.flags |= AIS_FRAME_HAS_QUALITY;
+		frame.quality = MIN(MAX(dbm, INT8_MIN), INT8_MAX);
+	}
+#endif
 
-		/* Calculate the checksum. */
-		uint8_t sum = 0;
+#ifdef CONFIG_APP_CHANNEL_PLAN
+	if (channel_plan_away(frame.channel)) {
+		frame.flags |= AIS_FRAME_AWAY;
+	}
+#endif
 
-		for (const char *q = nmea_buffer + 1; q < p; q++) {
-			sum ^= *q;
-		}
+#ifdef CONFIG_APP_RADIO_MONITOR
+	radio_monitor_frame(frame.channel);
+#endif
 
-		/* Add the checksum and the line end. */
-		p += sprintf(p, "*%02X\r\n", sum);
+#ifdef CONFIG_APP_TIME
+	ais_time_update(&frame);
+#endif
 
-		__ASSERT(PART_OF_ARRAY(nmea_buffer, p), "nmea_buffer overlow");
+#ifdef CONFIG_APP_CHANNEL_LOAD
+	if (!(frame.flags & AIS_FRAME_AWAY)) {
+		channel_load_update(frame.channel, frame.time_us, len * 8 + 16,
+				    true);
+	}
+#endif
 
-		tty_write(&tty, nmea_buffer, p - nmea_buffer);
+#ifdef CONFIG_APP_FILTER
+	if (!filter_accept(&frame)) {
+		return;
 	}
+#endif
 
-	if (multipart) {
-		multipart_counter++;
-		if (multipart_counter > 9) {
-			multipart_counter = 0;
-		}
+#ifdef CONFIG_APP_DEDUP
+	if (dedup_check(&frame)) {
+		return;
 	}
+#endif
+
+#ifdef CONFIG_APP_REDUCE
+	if (!reduce_accept(&frame)) {
+		return;
+	}
+#endif
+
+	output_publish(&frame);
 }
 
+#ifdef CONFIG_RADIO_CONFIG_DELTA
+/* Channel 2 is stored as a delta against channel 1. */
+#define CH2_STREAM(name)                                                       \
+	{ radio_config_ch1##name, radio_config_ch2##name##_delta }
+#else
+#define CH2_STREAM(name) { radio_config_ch2##name }
+#endif
+
 static const struct ais_config ais_configs[AIS_NUM_CHANNELS] = {
 	{
 		.dev_name = "RADIO_0",
-		.config_data = radio_config_ch1,
+		.config_data = { radio_config_ch1 },
+#ifdef CONFIG_APP_IRCAL_CACHE
+		.warm_data = { radio_config_ch1_warm },
+		.ircal_data = { radio_config_ch1_ircal },
+#endif
 		.callback = ch1_callback,
 	},
 	{
 		.dev_name = "RADIO_1",
-		.config_data = radio_config_ch2,
+		.config_data = CH2_STREAM(),
+#ifdef CONFIG_APP_IRCAL_CACHE
+		.warm_data = CH2_STREAM(_warm),
+		.ircal_data = CH2_STREAM(_ircal),
+#endif
 		.callback = ch2_callback,
 	},
 };
 
 static struct ais_state ais_states[AIS_NUM_CHANNELS];
 
+#ifndef CONFIG_APP_SIMULATE
+/* Both radios share the SPI bus, report how much of it configuration used. */
+static void report_radio_config(uint32_t cycles)
+{
+	uint64_t bus_cycles = 0;
+	uint64_t wait_cycles = 0;
+	uint32_t max_hold_cycles = 0;
+	uint32_t commands = 0;
+#ifdef CONFIG_SI4362_SCHED
+	uint32_t hold_bound_us = 0;
+#endif
+
+	for (int i = 0; i < ARRAY_SIZE(ais_states); i++) {
+		struct si4362_stats stats;
+
+		si4362_get_stats(ais_states[i].dev, &stats);
+		commands += stats.commands;
+		bus_cycles += stats.bus_cycles;
+		wait_cycles += stats.wait_cycles;
+		max_hold_cycles = MAX(max_hold_cycles, stats.max_hold_cycles);
+#ifdef CONFIG_SI4362_SCHED
+		hold_bound_us = MAX(hold_bound_us,
+				    si4362_max_hold_us(ais_states[i].dev));
+#endif
+	}
+
+	LOG_INF("radios configured in %u us, %u commands, receiving %u ms "
+		"after boot", k_cyc_to_us_floor32(cycles), commands,
+		(uint32_t)k_uptime_get());
+	LOG_INF("SPI bus busy %u us (%u%%), CTS wait %u us",
+		(uint32_t)k_cyc_to_us_floor64(bus_cycles),
+		(uint32_t)(bus_cycles * 100 / MAX(cycles, 1)),
+		(uint32_t)k_cyc_to_us_floor64(wait_cycles));
+#ifdef CONFIG_SI4362_SCHED
+	LOG_INF("longest transaction %u us, estimated bound %u us",
+		k_cyc_to_us_floor32(max_hold_cycles), hold_bound_us);
+#endif
+}
+#endif
+
+#ifdef CONFIG_APP_IRCAL_CACHE
+/*
+ * Radios are configured without calibration, apply cached results or
+ * calibrate the radios that have none.
+ */
+static void calibrate_radios(void)
+{
+	struct si4362_stream streams[AIS_NUM_CHANNELS][2] = { 0 };
+	struct si4362_init_cursor cursors[AIS_NUM_CHANNELS];
+	uint8_t indexes[AIS_NUM_CHANNELS];
+	size_t count = 0;
+
+	if (ircal_cache_init() < 0) {
+		LOG_ERR("Settings unavailable, calibration is not cached");
+	}
+
+	for (int i = 0; i < ARRAY_SIZE(ais_configs); i++) {
+		const struct si4362_stream *cal = &ais_configs[i].ircal_data;
+
+		if (ircal_cache_restore(ais_states[i].dev, i, cal) == 0) {
+			continue;
+		}
+
+		streams[count][0] = *cal;
+		cursors[count].dev = ais_states[i].dev;
+		cursors[count].streams = streams[count];
+		indexes[count++] = i;
+	}
+
+	if (count == 0) {
+		return;
+	}
+
+	int ret = si4362_send_init_commands_parallel(cursors, count);
+	if (ret < 0) {
+		LOG_ERR("Calibration failed: %d", ret);
+		return;
+	}
+
+	for (size_t j = 0; j < count; j++) {
+		uint8_t i = indexes[j];
+
+		ircal_cache_store(ais_states[i].dev, i,
+				  &ais_configs[i].ircal_data);
+	}
+}
+#endif
+
+#ifdef CONFIG_APP_RADIO_MONITOR
+/*
+ * Configure one radio again, including POWER_UP for a radio that reset
+ * itself after a brown-out. SDN is shared, so it is not used here and the
+ * other radio keeps receiving.
+ */
+static int recover_radio(uint8_t channel)
+{
+	struct ais_state *ais = &ais_states[channel];
+	const struct si4362_stream streams[] = {
+		{ radio_patch },
+		ais_configs[channel].config_data,
+	};
+	int ret = 0;
+
+#ifdef CONFIG_APP_CHANNEL_PLAN
+	/* A retune must not land in the middle of the configuration. */
+	channel_plan_pause(channel);
+#endif
+	si4362_configure_interrupt(ais->dev, false);
+
+	for (int i = 0; i < ARRAY_SIZE(streams) && ret == 0; i++) {
+		ret = si4362_send_init_commands(ais->dev, &streams[i]);
+	}
+
+	si4362_configure_interrupt(ais->dev, true);
+#ifdef CONFIG_APP_CHANNEL_PLAN
+	channel_plan_resume(channel);
+#endif
+
+	return ret;
+}
+
+static void start_monitor(void)
+{
+	const struct device *devs[AIS_NUM_CHANNELS];
+
+	for (int i = 0; i < ARRAY_SIZE(devs); i++) {
+		devs[i] = ais_states[i].dev;
+	}
+
+	radio_monitor_start(devs, recover_radio);
+}
+#endif
+
+#ifndef CONFIG_APP_SIMULATE
+static struct si4362_stream radio_streams[AIS_NUM_CHANNELS][3];
+static uint32_t radio_config_start;
+/* Time the configuration streams took, without the work done meanwhile. */
+static uint32_t radio_config_cycles;
+
+#ifdef CONFIG_SI4362_SCHED
+static struct si4362_upload radio_uploads[AIS_NUM_CHANNELS];
+static struct k_poll_signal radio_signals[AIS_NUM_CHANNELS];
+
+/* Queue the configuration of all radios, the scheduler interleaves them. */
+static void upload_radio_configs(void)
+{
+	for (int i = 0; i < ARRAY_SIZE(radio_uploads); i++) {
+		struct si4362_upload *upload = &radio_uploads[i];
+
+		k_poll_signal_init(&radio_signals[i]);
+		upload->dev = ais_states[i].dev;
+		upload->streams = radio_streams[i];
+		upload->prio = SI4362_PRIO_NORMAL;
+		upload->signal = &radio_signals[i];
+
+		int ret = si4362_send_commands_async(upload);
+		if (ret < 0) {
+			upload->done_cycles = k_cycle_get_32();
+			k_poll_signal_raise(&radio_signals[i], ret);
+		}
+	}
+}
+
+static int wait_radio_configs(void)
+{
+	int result = 0;
+
+	for (int i = 0; i < ARRAY_SIZE(radio_signals); i++) {
+		struct k_poll_event event;
+		unsigned int signaled;
+		int ret;
+
+		k_poll_event_init(&event, K_POLL_TYPE_SIGNAL,
+				  K_POLL_MODE_NOTIFY_ONLY, &radio_signals[i]);
+		k_poll(&event, 1, K_FOREVER);
+		k_poll_signal_check(&radio_signals[i], &signaled, &ret);
+
+		radio_config_cycles = MAX(radio_config_cycles,
+					  radio_uploads[i].done_cycles -
+					  radio_config_start);
+
+		if (ret < 0 && result == 0) {
+			result = ret;
+		}
+	}
+
+	return result;
+}
+#endif
+#endif
+
+/*
+ * Reset the radios and start configuring them. With the SPI scheduler
+ * this returns right away and start_reception() waits for the radios.
+ */
 static void init_radios(void)
 {
 	/* Reset devices first because of shared SDN. */
@@ -180,17 +445,88 @@ static void init_radios(void)
 #endif
 	}
 
+#ifndef CONFIG_APP_SIMULATE
+	radio_config_start = k_cycle_get_32();
+#endif
+
 	for (int i = 0; i < ARRAY_SIZE(ais_configs); i++) {
 		hdlc_init(&ais_states[i].hdlc, hdlc_callback);
+#ifdef CONFIG_APP_CHANNEL_LOAD
+		hdlc_set_error_callback(&ais_states[i].hdlc,
+					hdlc_error_callback);
+#endif
 #ifndef CONFIG_APP_SIMULATE
-		const struct ais_config *cfg = &ais_configs[i];
+		radio_streams[i][0].base = radio_patch;
+#ifdef CONFIG_APP_IRCAL_CACHE
+		radio_streams[i][1] = ais_configs[i].warm_data;
+#else
+		radio_streams[i][1] = ais_configs[i].config_data;
+#endif
+		radio_streams[i][2].base = NULL;
+#endif
+	}
+
+#ifndef CONFIG_APP_SIMULATE
+#ifdef CONFIG_SI4362_SCHED
+	upload_radio_configs();
+#else
+	struct si4362_init_cursor cursors[AIS_NUM_CHANNELS];
+
+	for (int i = 0; i < ARRAY_SIZE(cursors); i++) {
+		cursors[i].dev = ais_states[i].dev;
+		cursors[i].streams = radio_streams[i];
+	}
+
+	/* Each radio works on a command while the other one gets its next. */
+	int ret = si4362_send_init_commands_parallel(cursors,
+						     ARRAY_SIZE(cursors));
+	if (ret < 0) {
+		LOG_ERR("Failed to configure radios: %d", ret);
+	}
+
+	radio_config_cycles = k_cycle_get_32() - radio_config_start;
+#endif
+#endif
+}
+
+/* Finish the configuration of the radios and start receiving. */
+static void start_reception(void)
+{
+#ifndef CONFIG_APP_SIMULATE
+#ifdef CONFIG_SI4362_SCHED
+	int ret = wait_radio_configs();
+	if (ret < 0) {
+		LOG_ERR("Failed to configure radios: %d", ret);
+	}
+#endif
+
+	uint32_t start = k_cycle_get_32();
+
+#ifdef CONFIG_APP_IRCAL_CACHE
+	calibrate_radios();
+#endif
+
+	for (int i = 0; i < ARRAY_SIZE(ais_configs); i++) {
 		const struct device *dev = ais_states[i].dev;
-		si4362_send_init_commands(dev, radio_patch);
-		si4362_send_init_commands(dev, cfg->config_data);
-		si4362_set_callback(dev, cfg->callback);
-		si4362_configure_interrupt(dev, true);
+
+#ifdef CONFIG_APP_RSSI
+		rssi_init(&ais_states[i]);
 #endif
+		si4362_set_callback(dev, ais_configs[i].callback);
+		si4362_configure_interrupt(dev, true);
 	}
+
+	report_radio_config(radio_config_cycles + k_cycle_get_32() - start);
+
+#ifdef CONFIG_APP_RADIO_MONITOR
+	start_monitor();
+#endif
+
+#ifdef CONFIG_APP_CHANNEL_PLAN
+	channel_plan_start(ais_states[CONFIG_APP_CHANNEL_PLAN_RADIO].dev,
+			   CONFIG_APP_CHANNEL_PLAN_RADIO);
+#endif
+#endif
 }
 
 #ifdef CONFIG_APP_SIMULATE
@@ -237,31 +573,59 @@ static void start_simulation_thread(void)
 
 void main(void)
 {
+	/* The radios are configured while USB and the outputs come up. */
+	init_radios();
+
 	if (usb_enable(NULL)) {
 		k_oops();
 		return;
 	}
 
-	const struct device *dev = device_get_binding("CDC_ACM_0");
-	if (!dev) {
+	if (streams_init()) {
 		k_oops();
 		return;
 	}
 
-	tty_init(&tty, dev);
+	if (sinks_init()) {
+		LOG_ERR("Failed to initialize output sinks");
+	}
 
-	init_radios();
+	start_reception();
 
 #ifdef CONFIG_APP_SIMULATE
 	start_simulation_thread();
 #endif
 
 	for (;;) {
-		uint8_t msg;
+		uint32_t msg;
 		k_msgq_get(&ais_msgq, &msg, K_FOREVER);
-		int bit = msg & 1;
-		int idx = msg >> 1;
+		int bit = msg & AIS_MSG_BIT;
+		int idx = (msg >> AIS_MSG_CHANNEL_SHIFT) & 1;
+		struct ais_state *ais = &ais_states[idx];
+
+#ifdef CONFIG_APP_CAPTURE
+		enum capture_mode mode = capture_get_mode();
 
-		hdlc_input(&ais_states[idx].hdlc, bit);
+		if (mode != CAPTURE_OFF) {
+			capture_bit(idx, bit);
+		}
+
+		if (mode == CAPTURE_ONLY) {
+			continue;
+		}
+#endif
+
+		ais->bit_cycles = msg & AIS_MSG_CYCLES_MASK;
+#ifdef CONFIG_APP_RSSI
+		enum hdlc_state state = ais->hdlc.state;
+#endif
+		hdlc_input(&ais->hdlc, bit);
+#ifdef CONFIG_APP_RSSI
+		/* Start flag after a training sequence. */
+		if (state == HDLC_STATE_FINAL_ZERO &&
+		    ais->hdlc.state == HDLC_STATE_DATA && ais->hdlc.preamble) {
+			rssi_frame_start(ais);
+		}
+#endif
 	}
 }
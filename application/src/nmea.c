@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <string.h>
+
+#include "ais_time.h"
+#include "nmea.h"
+
+#define LOG_LEVEL CONFIG_LOG_DEFAULT_LEVEL
+#include <logging/log.h>
+LOG_MODULE_REGISTER(nmea);
+
+#define AIVDM_OVERHEAD (strlen("!AIVDM,0,0,0,A,,0,*00\r\n"))
+// Note: this is the limit for multipart messages, it is one greater for single
+// part.
+#define MAX_SENTENCE_CHARS (NMEA_MAX_LENGTH - AIVDM_OVERHEAD)
+
+#ifdef CONFIG_APP_NMEA_TAG_BLOCK
+#define TAG_SOURCE CONFIG_APP_NMEA_TAG_SOURCE
+#else
+#define TAG_SOURCE ""
+#endif
+
+/* Longest tag block: \c:<13 digits>,s:<source>,g:9-9-999*hh\ */
+BUILD_ASSERT(sizeof(TAG_SOURCE) - 1 + 36 <= NMEA_TAG_BLOCK_MAX_LENGTH,
+	     "Tag block source is too long");
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+static char *put_str(char *p, const char *s)
+{
+	while (*s) {
+		*p++ = *s++;
+	}
+
+	return p;
+}
+
+static char *put_uint(char *p, uint32_t n)
+{
+	char tmp[10];
+	int i = 0;
+
+	do {
+		tmp[i++] = '0' + n % 10;
+		n /= 10;
+	} while (n != 0);
+
+	while (i > 0) {
+		*p++ = tmp[--i];
+	}
+
+	return p;
+}
+
+/* Put '*', the checksum of [start, p) and return the new end. */
+static char *put_checksum(char *p, const char *start)
+{
+	uint8_t sum = 0;
+
+	for (const char *q = start; q < p; q++) {
+		sum ^= *q;
+	}
+
+	*p++ = '*';
+	*p++ = hex_digits[sum >> 4];
+	*p++ = hex_digits[sum & 0xf];
+
+	return p;
+}
+
+static char *put_time(char *p, uint64_t time_us)
+{
+	uint32_t sec = time_us / USEC_PER_SEC;
+
+	if (!IS_ENABLED(CONFIG_APP_NMEA_TAG_TIME_MS)) {
+		return put_uint(p, sec);
+	}
+
+	/* Avoid 64 bit formatting, print seconds and milliseconds apart. */
+	uint32_t ms = (uint32_t)(time_us % USEC_PER_SEC) / USEC_PER_MSEC;
+
+	if (sec == 0) {
+		return put_uint(p, ms);
+	}
+
+	p = put_uint(p, sec);
+	*p++ = '0' + ms / 100;
+	*p++ = '0' + (ms / 10) % 10;
+	*p++ = '0' + ms % 10;
+
+	return p;
+}
+
+static char *put_tag_block(struct nmea_encoder *enc, char *p,
+			   const struct ais_frame *frame,
+			   uint8_t part, uint8_t num_parts)
+{
+	char *start = p;
+
+	*p++ = '\\';
+
+	if (part == 1) {
+		uint64_t time_us = frame->time_us;
+
+#ifdef CONFIG_APP_TIME
+		/* UNIX time once UTC is known, uptime before that. */
+		ais_time_from_local(frame->time_us, &time_us);
+#endif
+		p = put_str(p, "c:");
+		p = put_time(p, time_us);
+		p = put_str(p, ",s:" TAG_SOURCE);
+		if (num_parts > 1) {
+			*p++ = ',';
+		}
+	}
+
+	if (num_parts > 1) {
+		p = put_str(p, "g:");
+		p = put_uint(p, part);
+		*p++ = '-';
+		p = put_uint(p, num_parts);
+		*p++ = '-';
+		p = put_uint(p, enc->group_id);
+	}
+
+	p = put_checksum(p, start + 1);
+	*p++ = '\\';
+
+	return p;
+}
+
+static char get_ascii6(const uint8_t *buf, uint16_t bit_offset)
+{
+	uint16_t byte_idx = bit_offset / 8;
+	uint16_t bit_idx = bit_offset % 8;
+	uint8_t n;
+
+	if (bit_idx <= 2) {
+		n = (buf[byte_idx] >> (2 - bit_idx)) & 0x3f;
+	} else {
+		n = ((buf[byte_idx] << (bit_idx - 2)) & 0x3f)
+		  | (buf[byte_idx + 1] >> (10 - bit_idx));
+	}
+
+	__ASSERT_NO_MSG(n < 64);
+
+	return (n >= 40) ? n + 56 : n + 48;
+}
+
+void nmea_encoder_init(struct nmea_encoder *enc)
+{
+	memset(enc, 0, sizeof(*enc));
+	enc->tag_block = IS_ENABLED(CONFIG_APP_NMEA_TAG_BLOCK);
+	enc->group_id = 1;
+}
+
+void nmea_encode(struct nmea_encoder *enc, const struct ais_frame *frame,
+		 nmea_sentence_cb cb, void *user_data)
+{
+	const uint8_t *buf = frame->data;
+	size_t len = frame->len;
+	uint16_t num_chars = ceiling_fraction(len * 8, 6);
+
+	bool multipart = num_chars > MAX_SENTENCE_CHARS + 1;
+	uint8_t num_parts = multipart ?
+		ceiling_fraction(num_chars, MAX_SENTENCE_CHARS) : 1;
+	LOG_DBG("len: %zu, chars: %u, parts: %u", len, num_chars, num_parts);
+
+	/* The channel field is left empty for other channels. */
+	char channel = 'A' + frame->channel;
+	uint16_t bit_offset = 0;
+	uint16_t remaining_chars = num_chars;
+
+	for (uint8_t part = 1; part <= num_parts; part++) {
+		char *p = enc->buffer;
+
+		if (enc->tag_block) {
+			p = put_tag_block(enc, p, frame, part, num_parts);
+		}
+
+		char *sentence = p;
+
+		/* Put header. */
+		p = put_str(p, "!AIVDM,");
+		p = put_uint(p, num_parts);
+		*p++ = ',';
+		p = put_uint(p, part);
+		*p++ = ',';
+		if (multipart) {
+			p = put_uint(p, enc->multipart_counter);
+		}
+		*p++ = ',';
+		if (!(frame->flags & AIS_FRAME_AWAY)) {
+			*p++ = channel;
+		}
+		*p++ = ',';
+
+		/* Put the data. */
+		uint16_t part_chars = remaining_chars;
+		if (multipart && remaining_chars > MAX_SENTENCE_CHARS) {
+			part_chars = MAX_SENTENCE_CHARS;
+		}
+
+		LOG_DBG("part: %u, chars: %u", part, part_chars);
+
+		for (int i = 0; i < part_chars; i++) {
+			*p++ = get_ascii6(buf, bit_offset);
+			bit_offset += 6;
+		}
+
+		remaining_chars -= part_chars;
+
+		/* Add pad info */
+		uint8_t pad = 0;
+
+		if (part == num_parts) {
+			__ASSERT_NO_MSG(num_chars * 6 >= len * 8);
+			pad = num_chars * 6 - len * 8;
+		}
+
+		*p++ = ',';
+		*p++ = '0' + pad;
+
+		/* Add the checksum and the line end. */
+		p = put_checksum(p, sentence + 1);
+		*p++ = '\r';
+		*p++ = '\n';
+
+		__ASSERT(PART_OF_ARRAY(enc->buffer, p), "nmea buffer overlow");
+
+		cb(enc->buffer, p - enc->buffer, user_data);
+	}
+
+	if (multipart) {
+		enc->multipart_counter++;
+		if (enc->multipart_counter > 9) {
+			enc->multipart_counter = 0;
+		}
+
+		enc->group_id++;
+		if (enc->group_id > 999) {
+			enc->group_id = 1;
+		}
+	}
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef APPLICATION_SRC_NMEA_H_
+#define APPLICATION_SRC_NMEA_H_
+
+#include <stdbool.h>
+#include "ais_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NMEA_MAX_LENGTH 82
+/* Tag block is limited to 80 characters plus the two delimiters. */
+#define NMEA_TAG_BLOCK_MAX_LENGTH 82
+
+/** Called for every complete sentence, including the line end. */
+typedef void (*nmea_sentence_cb)(const char *sentence, size_t len,
+				 void *user_data);
+
+struct nmea_encoder {
+	/** Prefix sentences with NMEA 4.x tag blocks. */
+	bool tag_block;
+	/** Sequential message identifier for multipart !AIVDM, 0 to 9. */
+	uint8_t multipart_counter;
+	/** Tag block group identifier, 1 to 999. */
+	uint16_t group_id;
+	char buffer[NMEA_TAG_BLOCK_MAX_LENGTH + NMEA_MAX_LENGTH + 1];
+};
+
+void nmea_encoder_init(struct nmea_encoder *enc);
+
+/**
+ * Encode a frame as one or more !AIVDM sentences.
+ *
+ * The callback is invoked synchronously for every sentence, the sentence
+ * buffer is reused between invocations.
+ */
+void nmea_encode(struct nmea_encoder *enc, const struct ais_frame *frame,
+		 nmea_sentence_cb cb, void *user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
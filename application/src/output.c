@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <shell/shell.h>
+
+#include "output.h"
+
+#define LOG_LEVEL CONFIG_LOG_DEFAULT_LEVEL
+#include <logging/log.h>
+LOG_MODULE_REGISTER(output);
+
+K_MEM_SLAB_DEFINE(packet_slab, sizeof(struct output_packet),
+		  CONFIG_APP_OUTPUT_PACKETS, 4);
+
+static uint32_t alloc_failures[OUTPUT_NUM_CLASSES];
+
+static const char *const class_names[] = {
+	[OUTPUT_CLASS_LOW] = "low",
+	[OUTPUT_CLASS_POSITION] = "position",
+	[OUTPUT_CLASS_SAFETY] = "safety",
+};
+
+void output_packet_unref(struct output_packet *pkt)
+{
+	if (atomic_dec(&pkt->refs) == 1) {
+		k_mem_slab_free(&packet_slab, (void **)&pkt);
+	}
+}
+
+static enum output_class classify(const struct ais_frame *frame)
+{
+	switch (frame->len != 0 ? frame->data[0] >> 2 : 0) {
+	case 6:
+	case 8:
+	case 12:
+	case 14:
+		return OUTPUT_CLASS_SAFETY;
+	case 1:
+	case 2:
+	case 3:
+	case 4:
+	case 9:
+	case 11:
+	case 18:
+	case 19:
+	case 21:
+	case 27:
+		return OUTPUT_CLASS_POSITION;
+	default:
+		return OUTPUT_CLASS_LOW;
+	}
+}
+
+/* Drop the oldest queued packet of a class, if there is one. */
+static bool sink_evict(struct output_sink *sink, enum output_class cls)
+{
+	struct output_packet *old;
+
+	if (k_msgq_get(sink->queues[cls], &old, K_NO_WAIT) != 0) {
+		return false;
+	}
+
+	/* Fails if the sink thread already waited for this packet. */
+	k_sem_take(sink->pending, K_NO_WAIT);
+	atomic_dec(&sink->queued);
+	sink->dropped[cls]++;
+	output_packet_unref(old);
+
+	return true;
+}
+
+/* Evict the oldest packet of the lowest class below cls. */
+static bool sink_shed(struct output_sink *sink, enum output_class cls)
+{
+	for (int c = OUTPUT_CLASS_LOW; c < cls; c++) {
+		if (sink_evict(sink, c)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void sink_enqueue(struct output_sink *sink, struct output_packet *pkt)
+{
+	if (atomic_get(&sink->queued) >= sink->depth &&
+	    !sink_shed(sink, pkt->cls) &&
+	    (sink->policy != OUTPUT_DROP_OLDEST ||
+	     !sink_evict(sink, pkt->cls))) {
+		sink->dropped[pkt->cls]++;
+		return;
+	}
+
+	atomic_inc(&pkt->refs);
+
+	if (k_msgq_put(sink->queues[pkt->cls], &pkt, K_NO_WAIT) != 0) {
+		sink->dropped[pkt->cls]++;
+		output_packet_unref(pkt);
+		return;
+	}
+
+	atomic_inc(&sink->queued);
+	k_sem_give(sink->pending);
+}
+
+static struct output_packet *packet_alloc(enum output_class cls)
+{
+	struct output_packet *pkt;
+
+	if (k_mem_slab_alloc(&packet_slab, (void **)&pkt, K_NO_WAIT) == 0) {
+		return pkt;
+	}
+
+	/*
+	 * The pool is held by packets queued in slow sinks. Shed lower
+	 * class packets, the pool only gains a packet once every sink
+	 * holding it has let go.
+	 */
+	for (size_t i = 0; i < output_num_sinks; i++) {
+		sink_shed(output_sinks[i], cls);
+	}
+
+	if (k_mem_slab_alloc(&packet_slab, (void **)&pkt, K_NO_WAIT) == 0) {
+		return pkt;
+	}
+
+	return NULL;
+}
+
+void output_publish(const struct ais_frame *frame)
+{
+	enum output_class cls = classify(frame);
+	struct output_packet *pkt = packet_alloc(cls);
+
+	if (pkt == NULL) {
+		alloc_failures[cls]++;
+		return;
+	}
+
+	size_t len = MIN(frame->len, OUTPUT_MAX_PAYLOAD);
+
+	/* Hold a reference while the packet is being distributed. */
+	atomic_set(&pkt->refs, 1);
+	pkt->cls = cls;
+	pkt->frame = *frame;
+	pkt->frame.data = pkt->data;
+	pkt->frame.len = len;
+	memcpy(pkt->data, frame->data, len);
+	pkt->data[len] = 0;
+
+	for (size_t i = 0; i < output_num_sinks; i++) {
+		sink_enqueue(output_sinks[i], pkt);
+	}
+
+	output_packet_unref(pkt);
+}
+
+static struct output_packet *sink_dequeue(struct output_sink *sink)
+{
+	struct output_packet *pkt;
+
+	for (int c = OUTPUT_NUM_CLASSES - 1; c >= 0; c--) {
+		if (k_msgq_get(sink->queues[c], &pkt, K_NO_WAIT) == 0) {
+			atomic_dec(&sink->queued);
+			return pkt;
+		}
+	}
+
+	/* The packet was evicted after the semaphore was given. */
+	return NULL;
+}
+
+void output_sink_set_idle(struct output_sink *sink,
+			  output_sink_idle_handler idle)
+{
+	sink->idle = idle;
+	/* Wake the thread so it starts waiting with a timeout. */
+	k_sem_give(sink->pending);
+}
+
+void output_sink_run(void *arg1, void *arg2, void *arg3)
+{
+	struct output_sink *sink = arg1;
+
+	for (;;) {
+		struct output_packet *pkt;
+
+		if (k_sem_take(sink->pending, sink->idle ? OUTPUT_IDLE_PERIOD :
+			       K_FOREVER) != 0) {
+			sink->idle(sink);
+			continue;
+		}
+
+		pkt = sink_dequeue(sink);
+		if (pkt == NULL) {
+			continue;
+		}
+
+		sink->handler(sink, pkt);
+		sink->delivered++;
+		output_packet_unref(pkt);
+	}
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_sinks(const struct shell *shell, size_t argc, char **argv)
+{
+	for (size_t i = 0; i < output_num_sinks; i++) {
+		const struct output_sink *sink = output_sinks[i];
+
+		shell_print(shell, "%-10s delivered: %u, queued: %u/%u",
+			    sink->name, sink->delivered,
+			    (uint32_t)atomic_get(&sink->queued), sink->depth);
+
+		for (int c = OUTPUT_NUM_CLASSES - 1; c >= 0; c--) {
+			shell_print(shell, "  %-8s queued: %u, dropped: %u",
+				    class_names[c],
+				    k_msgq_num_used_get(sink->queues[c]),
+				    sink->dropped[c]);
+		}
+	}
+
+	for (int c = OUTPUT_NUM_CLASSES - 1; c >= 0; c--) {
+		shell_print(shell, "packet pool exhausted (%s): %u",
+			    class_names[c], alloc_failures[c]);
+	}
+
+	return 0;
+}
+
+SHELL_CMD_REGISTER(sinks, NULL, "Show output sink statistics", cmd_sinks);
+#endif
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef APPLICATION_SRC_OUTPUT_H_
+#define APPLICATION_SRC_OUTPUT_H_
+
+#include <kernel.h>
+#include <sys/atomic.h>
+
+#include "ais_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OUTPUT_MAX_PAYLOAD 128
+
+/**
+ * Priority classes, under backpressure lower classes are shed first.
+ */
+enum output_class {
+	/** Static and voyage data (types 5 and 24) and everything else. */
+	OUTPUT_CLASS_LOW,
+	/** Position reports, base stations and aids to navigation. */
+	OUTPUT_CLASS_POSITION,
+	/** Safety related and binary messages (types 6, 8, 12 and 14). */
+	OUTPUT_CLASS_SAFETY,
+	OUTPUT_NUM_CLASSES,
+};
+
+/**
+ * A decoded frame shared between output sinks.
+ *
+ * The payload is copied once when the frame is published, every sink that
+ * received the packet holds a reference and releases it when done.
+ */
+struct output_packet {
+	atomic_t refs;
+	enum output_class cls;
+	/** Frame metadata, frame.data points to data below. */
+	struct ais_frame frame;
+	/* One extra zero byte for the 6 bit encoder. */
+	uint8_t data[OUTPUT_MAX_PAYLOAD + 1];
+};
+
+/**
+ * What to do when a sink queue is full and holds no packets of a lower
+ * class than the packet being published. Lower class packets are always
+ * evicted first.
+ */
+enum output_drop_policy {
+	/** Drop the packet being published. */
+	OUTPUT_DROP_NEWEST,
+	/** Drop the oldest queued packet of the same class. */
+	OUTPUT_DROP_OLDEST,
+};
+
+struct output_sink;
+
+/** Format and transmit a packet, may block at the pace of the sink. */
+typedef void (*output_sink_handler)(struct output_sink *sink,
+				    const struct output_packet *pkt);
+
+/** Called periodically while the sink queue is empty. */
+typedef void (*output_sink_idle_handler)(struct output_sink *sink);
+
+#define OUTPUT_IDLE_PERIOD K_MSEC(250)
+
+struct output_sink {
+	const char *name;
+	output_sink_handler handler;
+	output_sink_idle_handler idle;
+	enum output_drop_policy policy;
+	/** One queue per class, each can hold the whole budget. */
+	struct k_msgq *queues[OUTPUT_NUM_CLASSES];
+	/** Given for every queued packet. */
+	struct k_sem *pending;
+	/** Packets queued in all classes, at most depth. */
+	atomic_t queued;
+	uint8_t depth;
+	void *user_data;
+	uint32_t delivered;
+	uint32_t dropped[OUTPUT_NUM_CLASSES];
+};
+
+/**
+ * Define a sink with its own queue and thread.
+ *
+ * @param _name Sink variable name.
+ * @param _handler Sink handler.
+ * @param _policy Drop policy.
+ * @param _depth Number of packets the sink may have queued in all classes.
+ * @param _stack_size Stack size of the sink thread.
+ * @param _prio Priority of the sink thread.
+ * @param _user_data Opaque pointer for the handler.
+ */
+#define OUTPUT_SINK_DEFINE(_name, _handler, _policy, _depth, _stack_size,	\
+			   _prio, _user_data)					\
+	K_MSGQ_DEFINE(_name##_low, sizeof(struct output_packet *),		\
+		      _depth, 4);						\
+	K_MSGQ_DEFINE(_name##_position, sizeof(struct output_packet *),		\
+		      _depth, 4);						\
+	K_MSGQ_DEFINE(_name##_safety, sizeof(struct output_packet *),		\
+		      _depth, 4);						\
+	K_SEM_DEFINE(_name##_pending, 0, _depth);				\
+	static struct output_sink _name = {					\
+		.name = #_name,							\
+		.handler = _handler,						\
+		.policy = _policy,						\
+		.queues = {							\
+			[OUTPUT_CLASS_LOW] = &_name##_low,			\
+			[OUTPUT_CLASS_POSITION] = &_name##_position,		\
+			[OUTPUT_CLASS_SAFETY] = &_name##_safety,		\
+		},								\
+		.pending = &_name##_pending,					\
+		.depth = _depth,						\
+		.user_data = _user_data,					\
+	};									\
+	K_THREAD_DEFINE(_name##_thread, _stack_size, output_sink_run,		\
+			&_name, NULL, NULL, _prio, 0, 0)
+
+/** Sinks to publish to, provided by sinks.c. */
+extern struct output_sink *const output_sinks[];
+extern const size_t output_num_sinks;
+
+/**
+ * Publish a frame to all sinks.
+ *
+ * Called from the decoding thread, never blocks.
+ */
+void output_publish(const struct ais_frame *frame);
+
+void output_packet_unref(struct output_packet *pkt);
+
+/**
+ * Install an idle handler, called from the sink thread every
+ * OUTPUT_IDLE_PERIOD while there is nothing to deliver.
+ */
+void output_sink_set_idle(struct output_sink *sink,
+			  output_sink_idle_handler idle);
+
+/** Sink thread entry point, used by OUTPUT_SINK_DEFINE(). */
+void output_sink_run(void *arg1, void *arg2, void *arg3);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
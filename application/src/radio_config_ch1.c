@@ -1,5 +1,22 @@
 #include "radio_configs.h"
 #include <autoconf.h>
+
+#ifdef CONFIG_RADIO_CONFIG_COMPACT
+/* Generated by scripts/radio_config.py. */
+const uint8_t radio_config_ch1[] = {
+#include <radio_config_ch1.inc>
+};
+
+#ifdef CONFIG_APP_IRCAL_CACHE
+const uint8_t radio_config_ch1_warm[] = {
+#include <radio_config_ch1_warm.inc>
+};
+
+const uint8_t radio_config_ch1_ircal[] = {
+#include <radio_config_ch1_ircal.inc>
+};
+#endif
+#else
 #ifndef CONFIG_RADIO_IQ_CALIBRATION
 #include "radio_config_ch1.h"
 #else
@@ -7,3 +24,4 @@
 #endif
 
 const uint8_t radio_config_ch1[] = RADIO_CONFIGURATION_DATA_ARRAY;
+#endif
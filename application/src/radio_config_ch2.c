@@ -1,5 +1,37 @@
 #include "radio_configs.h"
 #include <autoconf.h>
+
+#if defined(CONFIG_RADIO_CONFIG_DELTA)
+/* Generated by scripts/radio_config.py, deltas against channel 1. */
+const uint8_t radio_config_ch2_delta[] = {
+#include <radio_config_ch2_delta.inc>
+};
+
+#ifdef CONFIG_APP_IRCAL_CACHE
+const uint8_t radio_config_ch2_warm_delta[] = {
+#include <radio_config_ch2_warm_delta.inc>
+};
+
+const uint8_t radio_config_ch2_ircal_delta[] = {
+#include <radio_config_ch2_ircal_delta.inc>
+};
+#endif
+#elif defined(CONFIG_RADIO_CONFIG_COMPACT)
+/* Generated by scripts/radio_config.py. */
+const uint8_t radio_config_ch2[] = {
+#include <radio_config_ch2.inc>
+};
+
+#ifdef CONFIG_APP_IRCAL_CACHE
+const uint8_t radio_config_ch2_warm[] = {
+#include <radio_config_ch2_warm.inc>
+};
+
+const uint8_t radio_config_ch2_ircal[] = {
+#include <radio_config_ch2_ircal.inc>
+};
+#endif
+#else
 #ifndef CONFIG_RADIO_IQ_CALIBRATION
 #include "radio_config_ch2.h"
 #else
@@ -7,3 +39,4 @@
 #endif
 
 const uint8_t radio_config_ch2[] = RADIO_CONFIGURATION_DATA_ARRAY;
+#endif
@@ -6,4 +6,22 @@ extern const uint8_t radio_config_ch1[];
 extern const uint8_t radio_config_ch2[];
 extern const uint8_t radio_patch[];
 
+/*
+ * With the calibration cache the configuration is split: the warm stream
+ * configures a radio without calibrating, the ircal stream calibrates a
+ * radio that is already up.
+ */
+extern const uint8_t radio_config_ch1_warm[];
+extern const uint8_t radio_config_ch1_ircal[];
+extern const uint8_t radio_config_ch2_warm[];
+extern const uint8_t radio_config_ch2_ircal[];
+
+/*
+ * With CONFIG_RADIO_CONFIG_DELTA channel 2 streams are deltas against
+ * the channel 1 ones, see struct si4362_stream.
+ */
+extern const uint8_t radio_config_ch2_delta[];
+extern const uint8_t radio_config_ch2_warm_delta[];
+extern const uint8_t radio_config_ch2_ircal_delta[];
+
 #endif
@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <shell/shell.h>
+#include <sys/atomic.h>
+
+#include "radio_monitor.h"
+#include "si4362.h"
+
+#define LOG_LEVEL CONFIG_LOG_DEFAULT_LEVEL
+#include <logging/log.h>
+LOG_MODULE_REGISTER(radio_monitor);
+
+#define PERIOD_MS (CONFIG_APP_RADIO_MONITOR_PERIOD * MSEC_PER_SEC)
+#define SILENCE_MS (CONFIG_APP_RADIO_MONITOR_SILENCE * MSEC_PER_SEC)
+#define BUDGET_PPM CONFIG_APP_RADIO_MONITOR_BUDGET
+
+struct radio {
+	const struct device *dev;
+	atomic_t frames;
+	uint32_t last_frames;
+	/** Time the channel has been silent while the other one was not. */
+	uint32_t silent_ms;
+	uint8_t state;
+	/** Bus time of the checks. */
+	uint64_t bus_cycles;
+	struct radio_monitor_stats stats;
+};
+
+static struct radio radios[AIS_NUM_CHANNELS];
+static radio_monitor_recover_t recover_cb;
+static int64_t start_ms;
+static struct k_spinlock lock;
+
+static void monitor_thread(void *p1, void *p2, void *p3);
+
+K_THREAD_DEFINE(radio_monitor, CONFIG_APP_RADIO_MONITOR_STACK_SIZE,
+		monitor_thread, NULL, NULL, NULL,
+		K_LOWEST_APPLICATION_THREAD_PRIO, 0, SYS_FOREVER_MS);
+
+/* A low priority transaction, waits for it to complete. */
+static int low_prio_xfer(const struct device *dev, uint8_t flags,
+			 const uint8_t *cmd, size_t cmd_len, uint8_t *resp,
+			 size_t resp_len)
+{
+	struct k_poll_signal signal;
+	struct k_poll_event event;
+	struct si4362_xfer xfer = {
+		.dev = dev,
+		.cmd = cmd,
+		.cmd_len = cmd_len,
+		.resp = resp,
+		.resp_len = resp_len,
+		.flags = flags,
+		.prio = SI4362_PRIO_LOW,
+		.signal = &signal,
+	};
+	unsigned int signaled;
+	int result;
+
+	k_poll_signal_init(&signal);
+	k_poll_event_init(&event, K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY,
+			  &signal);
+
+	int ret = si4362_submit(&xfer);
+	if (ret < 0) {
+		return ret;
+	}
+
+	k_poll(&event, 1, K_FOREVER);
+	k_poll_signal_check(&signal, &signaled, &result);
+
+	return result;
+}
+
+static int read_state(const struct device *dev, uint8_t *state)
+{
+	const uint8_t cmd = SI4362_CMD_FRR_B_READ;
+
+	return low_prio_xfer(dev, SI4362_XFER_IMMEDIATE, &cmd, sizeof(cmd),
+			     state, 1);
+}
+
+static int request_state(const struct device *dev, uint8_t *state)
+{
+	const uint8_t cmd = SI4362_CMD_REQUEST_DEVICE_STATE;
+	/* CURR_STATE and CURRENT_CHANNEL. */
+	uint8_t resp[2];
+
+	int ret = low_prio_xfer(dev, 0, &cmd, sizeof(cmd), resp, sizeof(resp));
+	if (ret < 0) {
+		return ret;
+	}
+
+	*state = resp[0];
+	return 0;
+}
+
+static int configure_frr(const struct device *dev)
+{
+	const uint8_t mode = SI4362_FRR_MODE_CURRENT_STATE;
+
+	return si4362_set_properties(dev, SI4362_PROP_GROUP_FRR_CTL,
+				     SI4362_PROP_FRR_CTL_B_MODE, &mode, 1);
+}
+
+/* RX_TUNE is seen while the channel plan retunes the radio. */
+static bool receiving(uint8_t state)
+{
+	state &= SI4362_STATE_MASK;
+
+	return state == SI4362_STATE_RX || state == SI4362_STATE_RX_TUNE;
+}
+
+static void recover(uint8_t channel, const char *reason)
+{
+	struct radio *radio = &radios[channel];
+	uint32_t start = k_cycle_get_32();
+
+	LOG_WRN("%s: %s, recovering", radio->dev->name, reason);
+
+	int ret = recover_cb(channel);
+	if (ret == 0) {
+		ret = configure_frr(radio->dev);
+	}
+	if (ret == 0) {
+		ret = request_state(radio->dev, &radio->state);
+	}
+
+	uint32_t us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	radio->stats.recoveries++;
+	radio->stats.last_recovery_us = us;
+	radio->stats.max_recovery_us = MAX(radio->stats.max_recovery_us, us);
+	if (ret < 0 || !receiving(radio->state)) {
+		radio->stats.failures++;
+	}
+	k_spin_unlock(&lock, key);
+
+	if (ret < 0 || !receiving(radio->state)) {
+		/* SDN is shared, only a power cycle resets a dead radio. */
+		LOG_ERR("%s: recovery failed (%d), state 0x%02x",
+			radio->dev->name, ret, radio->state);
+	} else {
+		LOG_INF("%s: receiving again after %u us", radio->dev->name,
+			us);
+	}
+
+	radio->silent_ms = 0;
+	radio->last_frames = atomic_get(&radio->frames);
+}
+
+static void check(uint8_t channel, uint32_t elapsed_ms)
+{
+	struct radio *radio = &radios[channel];
+	struct radio *other = &radios[channel ^ 1];
+	struct si4362_stats before;
+	struct si4362_stats after;
+
+	uint32_t frames = atomic_get(&radio->frames);
+	uint32_t other_frames = atomic_get(&other->frames);
+
+	if (frames != radio->last_frames) {
+		radio->silent_ms = 0;
+	} else if (other_frames != other->last_frames) {
+		radio->silent_ms += elapsed_ms;
+	}
+
+	si4362_get_stats(radio->dev, &before);
+	int ret = read_state(radio->dev, &radio->state);
+
+	bool suspect = ret < 0 || !receiving(radio->state) ||
+		       radio->silent_ms >= SILENCE_MS;
+	if (suspect) {
+		/* FRR B is lost if the radio reset itself, ask properly. */
+		ret = request_state(radio->dev, &radio->state);
+	}
+	si4362_get_stats(radio->dev, &after);
+
+	radio->bus_cycles += after.bus_cycles - before.bus_cycles;
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	radio->stats.checks++;
+	radio->stats.bus_ppm = k_cyc_to_us_ceil64(radio->bus_cycles) *
+			       USEC_PER_MSEC / MAX(k_uptime_get() - start_ms, 1);
+	k_spin_unlock(&lock, key);
+
+	if (ret < 0) {
+		recover(channel, "no response");
+	} else if (!receiving(radio->state)) {
+		recover(channel, "not receiving");
+	} else if (radio->silent_ms >= SILENCE_MS) {
+		recover(channel, "silent");
+	}
+}
+
+static void monitor_thread(void *p1, void *p2, void *p3)
+{
+	uint32_t period_ms = PERIOD_MS;
+
+	for (int i = 0; i < ARRAY_SIZE(radios); i++) {
+		if (configure_frr(radios[i].dev) < 0) {
+			LOG_ERR("%s: failed to configure FRR B",
+				radios[i].dev->name);
+		}
+	}
+
+	start_ms = k_uptime_get();
+
+	for (;;) {
+		k_sleep(K_MSEC(period_ms));
+
+		uint64_t round_cycles = 0;
+
+		for (int i = 0; i < ARRAY_SIZE(radios); i++) {
+			uint64_t bus_cycles = radios[i].bus_cycles;
+
+			check(i, period_ms);
+			round_cycles += radios[i].bus_cycles - bus_cycles;
+		}
+
+		for (int i = 0; i < ARRAY_SIZE(radios); i++) {
+			radios[i].last_frames = atomic_get(&radios[i].frames);
+		}
+
+		/* Check less often if a round takes more than the budget. */
+		uint32_t min_ms = k_cyc_to_us_ceil64(round_cycles) *
+				  MSEC_PER_SEC / BUDGET_PPM;
+		period_ms = MAX(PERIOD_MS, min_ms);
+	}
+}
+
+void radio_monitor_start(const struct device *const devs[AIS_NUM_CHANNELS],
+			 radio_monitor_recover_t recover)
+{
+	for (int i = 0; i < ARRAY_SIZE(radios); i++) {
+		radios[i].dev = devs[i];
+	}
+
+	recover_cb = recover;
+	k_thread_start(radio_monitor);
+}
+
+void radio_monitor_frame(uint8_t channel)
+{
+	atomic_inc(&radios[channel].frames);
+}
+
+void radio_monitor_get_stats(uint8_t channel,
+			     struct radio_monitor_stats *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	*stats = radios[channel].stats;
+	k_spin_unlock(&lock, key);
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_radios(const struct shell *shell, size_t argc, char **argv)
+{
+	shell_print(shell, "ch state  checks recov fail  last_us   max_us  ppm");
+
+	for (int i = 0; i < ARRAY_SIZE(radios); i++) {
+		struct radio_monitor_stats s;
+
+		radio_monitor_get_stats(i, &s);
+		shell_print(shell, "%c  0x%02x %7u %5u %4u %8u %8u %4u",
+			    'A' + i, radios[i].state, s.checks, s.recoveries,
+			    s.failures, s.last_recovery_us, s.max_recovery_us,
+			    s.bus_ppm);
+	}
+
+	return 0;
+}
+
+SHELL_CMD_REGISTER(radios, NULL, "Show radio health", cmd_radios);
+#endif
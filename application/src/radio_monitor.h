@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef APPLICATION_SRC_RADIO_MONITOR_H_
+#define APPLICATION_SRC_RADIO_MONITOR_H_
+
+#include <device.h>
+
+#include "ais_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Configure a radio again while the other one keeps receiving. Called
+ * from the monitor thread.
+ *
+ * @return 0 on success.
+ */
+typedef int (*radio_monitor_recover_t)(uint8_t channel);
+
+struct radio_monitor_stats {
+	uint32_t checks;
+	uint32_t recoveries;
+	/** Recoveries that did not bring the radio back. */
+	uint32_t failures;
+	/** Time from detection until the radio was receiving again. */
+	uint32_t last_recovery_us;
+	uint32_t max_recovery_us;
+	/** Share of the bus time used by the checks, in parts per million. */
+	uint32_t bus_ppm;
+};
+
+/**
+ * Start watching the radios.
+ *
+ * A low priority thread reads the state of every radio from fast
+ * response register B once every CONFIG_APP_RADIO_MONITOR_PERIOD
+ * seconds, a single SPI transaction. When a radio is not receiving, or
+ * its channel has been silent for CONFIG_APP_RADIO_MONITOR_SILENCE
+ * seconds while the other channel received frames, the state is
+ * confirmed with REQUEST_DEVICE_STATE and the radio is recovered. The
+ * period is stretched when the checks would use more than
+ * CONFIG_APP_RADIO_MONITOR_BUDGET ppm of the bus.
+ *
+ * @param devs Radio of every channel.
+ */
+void radio_monitor_start(const struct device *const devs[AIS_NUM_CHANNELS],
+			 radio_monitor_recover_t recover);
+
+/** Account a valid frame received on a channel. */
+void radio_monitor_frame(uint8_t channel);
+
+void radio_monitor_get_stats(uint8_t channel,
+			     struct radio_monitor_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
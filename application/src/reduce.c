@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <stdlib.h>
+#include <shell/shell.h>
+#include <ais_msg.h>
+
+#include "output.h"
+#include "reduce.h"
+
+#define TABLE_SIZE CONFIG_APP_REDUCE_TABLE_SIZE
+#define TABLE_MASK (TABLE_SIZE - 1)
+#define MAX_PROBES 8
+
+BUILD_ASSERT((TABLE_SIZE & TABLE_MASK) == 0,
+	     "Reduce table size must be a power of two");
+
+/* Types 1, 2, 3, 18 and 19. */
+#define POSITION_TYPES \
+	(BIT64(1) | BIT64(2) | BIT64(3) | BIT64(18) | BIT64(19))
+
+/* Class B reports have no navigational status. */
+#define STATUS_NONE 0xff
+
+/*
+ * Positions are in 1/10000 minutes, 1852 / 10000 meters of latitude. Longitude
+ * is scaled by cos(lat), looked up per 10 degrees in 1/256 units.
+ */
+#define POS_UNITS_PER_KM 5400
+static const uint8_t cos_lat[] = {
+	255, 252, 241, 222, 196, 165, 128, 88, 44, 0,
+};
+
+struct reduce_entry {
+	uint32_t mmsi;
+	uint32_t time_ms;
+	int32_t lon;
+	int32_t lat;
+	uint8_t status;
+};
+
+struct reduce_config {
+	uint32_t min_interval_ms;
+	uint32_t max_interval_ms;
+	uint32_t deadband_m;
+};
+
+static struct reduce_config config = {
+	.min_interval_ms = CONFIG_APP_REDUCE_MIN_INTERVAL * MSEC_PER_SEC,
+	.max_interval_ms = CONFIG_APP_REDUCE_MAX_INTERVAL * MSEC_PER_SEC,
+	.deadband_m = CONFIG_APP_REDUCE_DEADBAND,
+};
+
+static struct k_spinlock lock;
+static struct reduce_entry table[TABLE_SIZE];
+static uint32_t dropped_rate;
+static uint32_t dropped_deadband;
+
+static inline uint32_t hash(uint32_t mmsi)
+{
+	return (mmsi * 2654435761U) >> 16;
+}
+
+static struct reduce_entry *lookup(uint32_t mmsi, uint32_t now,
+				   uint32_t max_age, bool *found)
+{
+	uint32_t idx = hash(mmsi);
+	struct reduce_entry *free_entry = NULL;
+	struct reduce_entry *oldest = NULL;
+
+	for (int i = 0; i < MAX_PROBES; i++) {
+		struct reduce_entry *e = &table[(idx + i) & TABLE_MASK];
+
+		if (e->mmsi == mmsi) {
+			*found = true;
+			return e;
+		}
+
+		if (e->mmsi == 0 || now - e->time_ms >= max_age) {
+			if (free_entry == NULL) {
+				free_entry = e;
+			}
+		} else if (oldest == NULL ||
+			   now - e->time_ms > now - oldest->time_ms) {
+			oldest = e;
+		}
+	}
+
+	*found = false;
+
+	return free_entry != NULL ? free_entry : oldest;
+}
+
+static bool within_deadband(const struct reduce_entry *e,
+			    const struct ais_position *pos, uint32_t deadband_m)
+{
+	int32_t lat_deg = abs(pos->lat) / 600000;
+	int64_t dlat = pos->lat - e->lat;
+	int64_t dlon = pos->lon - e->lon;
+	int64_t limit = (int64_t)deadband_m * POS_UNITS_PER_KM / 1000;
+
+	if (pos->lat == AIS_LAT_NOT_AVAILABLE ||
+	    pos->lon == AIS_LON_NOT_AVAILABLE) {
+		return false;
+	}
+
+	dlon = dlon * cos_lat[MIN(lat_deg / 10, ARRAY_SIZE(cos_lat) - 1)] / 256;
+
+	return dlat * dlat + dlon * dlon < limit * limit;
+}
+
+bool reduce_accept(const struct ais_frame *frame)
+{
+	uint8_t buf[OUTPUT_MAX_PAYLOAD + AIS_MSG_BUFFER_PADDING] = { 0 };
+	size_t len = MIN(frame->len, OUTPUT_MAX_PAYLOAD);
+	uint32_t now = frame->time_us / USEC_PER_MSEC;
+	const struct ais_position *pos;
+	struct reduce_entry *e;
+	struct ais_msg msg;
+	uint8_t status;
+	bool found;
+
+	/* Only the position reports are of interest, skip the parser. */
+	if (len == 0 || !(POSITION_TYPES & BIT64(frame->data[0] >> 2))) {
+		return true;
+	}
+
+	memcpy(buf, frame->data, len);
+
+	if (ais_msg_parse(buf, len, &msg) < 0 || msg.mmsi == 0) {
+		return true;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct reduce_config cfg = config;
+	k_spin_unlock(&lock, key);
+
+	pos = ais_msg_position(&msg);
+	status = msg.type <= 3 ? msg.class_a.status : STATUS_NONE;
+	e = lookup(msg.mmsi, now, cfg.max_interval_ms, &found);
+
+	if (found && status == e->status &&
+	    now - e->time_ms < cfg.max_interval_ms) {
+		if (now - e->time_ms < cfg.min_interval_ms) {
+			dropped_rate++;
+			return false;
+		}
+
+		if (within_deadband(e, pos, cfg.deadband_m)) {
+			dropped_deadband++;
+			return false;
+		}
+	}
+
+	e->mmsi = msg.mmsi;
+	e->time_ms = now;
+	e->lon = pos->lon;
+	e->lat = pos->lat;
+	e->status = status;
+
+	return true;
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_reduce_show(const struct shell *shell, size_t argc,
+			   char **argv)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct reduce_config cfg = config;
+	k_spin_unlock(&lock, key);
+
+	shell_print(shell, "interval: %u..%u s",
+		    cfg.min_interval_ms / MSEC_PER_SEC,
+		    cfg.max_interval_ms / MSEC_PER_SEC);
+	shell_print(shell, "dead band: %u m", cfg.deadband_m);
+	shell_print(shell, "dropped by interval: %u", dropped_rate);
+	shell_print(shell, "dropped by dead band: %u", dropped_deadband);
+
+	return 0;
+}
+
+static int cmd_reduce_interval(const struct shell *shell, size_t argc,
+			       char **argv)
+{
+	uint32_t min_s = strtoul(argv[1], NULL, 0);
+	uint32_t max_s = strtoul(argv[2], NULL, 0);
+
+	if (max_s < min_s) {
+		shell_error(shell, "max must not be less than min");
+		return -EINVAL;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	config.min_interval_ms = min_s * MSEC_PER_SEC;
+	config.max_interval_ms = max_s * MSEC_PER_SEC;
+	k_spin_unlock(&lock, key);
+
+	return 0;
+}
+
+static int cmd_reduce_deadband(const struct shell *shell, size_t argc,
+			       char **argv)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	config.deadband_m = strtoul(argv[1], NULL, 0);
+	k_spin_unlock(&lock, key);
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_reduce,
+	SHELL_CMD(show, NULL, "Show reduction settings", cmd_reduce_show),
+	SHELL_CMD_ARG(interval, NULL, "Set min and max report interval <s>",
+		      cmd_reduce_interval, 3, 0),
+	SHELL_CMD_ARG(deadband, NULL, "Set position dead band <m>",
+		      cmd_reduce_deadband, 2, 0),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(reduce, &sub_reduce, "Output reduction policies", NULL);
+#endif
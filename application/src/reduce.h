@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef APPLICATION_SRC_REDUCE_H_
+#define APPLICATION_SRC_REDUCE_H_
+
+#include <stdbool.h>
+#include "ais_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Apply the output reduction policies to a frame.
+ *
+ * Position reports of a vessel are dropped if they arrive within the
+ * minimum interval of the last forwarded report, or if the vessel moved
+ * less than the dead band since then. A navigational status change is
+ * always forwarded, as is any report older than the maximum interval and
+ * all messages without a position. Both limits can be changed with the
+ * "reduce" shell command.
+ *
+ * State is kept in a fixed size table of CONFIG_APP_REDUCE_TABLE_SIZE
+ * vessels.
+ *
+ * @return true if the frame should be forwarded.
+ */
+bool reduce_accept(const struct ais_frame *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -7,9 +7,11 @@
 #define DT_DRV_COMPAT silabs_si4362
 
 #include <errno.h>
+#include <string.h>
 #include <device.h>
 #include <init.h>
 #include <drivers/spi.h>
+#include <sys/byteorder.h>
 
 #include "si4362.h"
 
@@ -19,6 +21,9 @@ LOG_MODULE_REGISTER(si4362);
 
 #define SI4362_RESET_DELAY K_MSEC(10)
 #define SI4362_CTS_TIMEOUT 10000
+/* Power up with a patch is the slowest command, it takes about 15 ms. */
+#define SI4362_CTS_WAIT_MS 100
+#define SI4362_CTS_WAIT K_MSEC(SI4362_CTS_WAIT_MS)
 
 static void rx_clock_callback_handler(const struct device *port,
 	struct gpio_callback *cb, gpio_port_pins_t pins)
@@ -93,9 +98,25 @@ void si4362_set_callback(const struct device *dev, si4362_rx_callback callback)
 	drv_data->rx_callback = callback;
 }
 
+static void account_bus(struct si4362_drv_data *drv_data, uint32_t start,
+			size_t bytes)
+{
+	uint32_t cycles = k_cycle_get_32() - start;
+
+	drv_data->stats.transactions++;
+	drv_data->stats.bus_cycles += cycles;
+	drv_data->stats.max_hold_cycles =
+		MAX(drv_data->stats.max_hold_cycles, cycles);
+	/* Setup is included, so short transactions count as slow bytes. */
+	drv_data->stats.max_byte_cycles =
+		MAX(drv_data->stats.max_byte_cycles,
+		    ceiling_fraction(cycles, MAX(bytes, 1)));
+}
+
 static int send_command(const struct device *dev, size_t len, const void *data)
 {
 	struct si4362_drv_data *drv_data = dev->data;
+	uint32_t start = k_cycle_get_32();
 	int ret;
 
 	const struct spi_buf tx_buf[] = {
@@ -112,12 +133,17 @@ static int send_command(const struct device *dev, size_t len, const void *data)
 
 	ret = spi_write(drv_data->spi, &drv_data->spi_cfg, &tx);
 	spi_release(drv_data->spi, &drv_data->spi_cfg);
+
+	drv_data->stats.commands++;
+	account_bus(drv_data, start, len);
 	return ret;
 }
 
+/* Read CTS and the response in a single transaction. */
 static int get_response(const struct device *dev, size_t len, void *data)
 {
 	struct si4362_drv_data *drv_data = dev->data;
+	uint32_t start = k_cycle_get_32();
 	int ret;
 
 	uint8_t cmd = 0x44;
@@ -129,7 +155,7 @@ static int get_response(const struct device *dev, size_t len, void *data)
 			.buf = &cmd,
 		},
 		{
-			.len = 1,
+			.len = 1 + len,
 			.buf = NULL,
 		},
 	};
@@ -143,6 +169,10 @@ static int get_response(const struct device *dev, size_t len, void *data)
 			.len = 1,
 			.buf = &cts,
 		},
+		{
+			.len = len,
+			.buf = data,
+		},
 	};
 
 	const struct spi_buf_set tx = {
@@ -152,53 +182,139 @@ static int get_response(const struct device *dev, size_t len, void *data)
 
 	const struct spi_buf_set rx = {
 		.buffers = rx_buf,
-		.count = ARRAY_SIZE(rx_buf),
+		.count = len > 0 ? ARRAY_SIZE(rx_buf) : ARRAY_SIZE(rx_buf) - 1,
 	};
 
 	ret = spi_transceive(drv_data->spi, &drv_data->spi_cfg, &tx, &rx);
+	spi_release(drv_data->spi, &drv_data->spi_cfg);
+
+	account_bus(drv_data, start, 2 + len);
 
 	if (ret < 0) {
-		goto ret_unlock;
+		return ret;
 	}
 
-	if (cts != 0xff) {
-		ret = -EAGAIN;
-		goto ret_unlock;
-	}
+	return cts == 0xff ? 0 : -EAGAIN;
+}
 
-	/* read the response. */
-	ret = 0;
-	if (len > 0) {
-		const struct spi_buf resp_buf[] = {
-			{
-				.len = len,
-				.buf = data,
-			},
-		};
+/* Send a command and read its response in the same transaction. */
+static int read_immediate(const struct device *dev, size_t tx_len,
+			  const void *data_tx, size_t rx_len, void *data_rx)
+{
+	struct si4362_drv_data *drv_data = dev->data;
+	uint32_t start = k_cycle_get_32();
+	int ret;
 
-		const struct spi_buf_set resp_rx = {
-			.buffers = resp_buf,
-			.count = ARRAY_SIZE(resp_buf),
-		};
+	const struct spi_buf tx_buf[] = {
+		{
+			.len = tx_len,
+			.buf = (void *)data_tx,
+		},
+		{
+			.len = rx_len,
+			.buf = NULL,
+		},
+	};
 
-		ret = spi_read(drv_data->spi, &drv_data->spi_cfg, &resp_rx);
-	}
+	const struct spi_buf rx_buf[] = {
+		{
+			.len = tx_len,
+			.buf = NULL,
+		},
+		{
+			.len = rx_len,
+			.buf = data_rx,
+		},
+	};
+
+	const struct spi_buf_set tx = {
+		.buffers = tx_buf,
+		.count = ARRAY_SIZE(tx_buf),
+	};
+
+	const struct spi_buf_set rx = {
+		.buffers = rx_buf,
+		.count = ARRAY_SIZE(rx_buf),
+	};
 
-ret_unlock:
+	ret = spi_transceive(drv_data->spi, &drv_data->spi_cfg, &tx, &rx);
 	spi_release(drv_data->spi, &drv_data->spi_cfg);
+
+	account_bus(drv_data, start, tx_len + rx_len);
 	return ret;
 }
 
+static void cts_callback_handler(const struct device *port,
+	struct gpio_callback *cb, gpio_port_pins_t pins)
+{
+	struct si4362_drv_data *drv_data =
+		CONTAINER_OF(cb, struct si4362_drv_data, cts_cb);
+
+	k_sem_give(&drv_data->cts_sem);
+}
+
+/*
+ * Wait for the rising edge of CTS without touching the bus. The level is
+ * checked as well in case the edge came before the interrupt could be
+ * taken.
+ */
+static int wait_cts(const struct device *dev)
+{
+	struct si4362_drv_data *drv_data = dev->data;
+	uint32_t start = k_cycle_get_32();
+	int ret = 0;
+
+	if (k_sem_take(&drv_data->cts_sem, SI4362_CTS_WAIT) != 0 &&
+	    si4362_get_cts(dev) <= 0) {
+		ret = -EIO;
+	}
+
+	drv_data->stats.wait_cycles += k_cycle_get_32() - start;
+	return ret;
+}
+
+#ifdef CONFIG_SI4362_SCHED
+static int sched_transceive(const struct device *dev, enum si4362_prio prio,
+			    uint8_t flags, size_t tx_len, const void *data_tx,
+			    size_t rx_len, void *data_rx);
+#endif
+
 static int transceive(const struct device *dev,
 		      size_t tx_len, const void *data_tx,
 		      size_t rx_len, void *data_rx)
 {
+	struct si4362_drv_data *drv_data = dev->data;
 	int ret;
+
+#ifdef CONFIG_SI4362_SCHED
+	if (drv_data->cts_dev) {
+		return sched_transceive(dev, SI4362_PRIO_NORMAL, 0, tx_len,
+					data_tx, rx_len, data_rx);
+	}
+#endif
+
+	if (drv_data->cts_dev) {
+		k_sem_reset(&drv_data->cts_sem);
+	}
+
 	ret = send_command(dev, tx_len, data_tx);
 	if (ret < 0) {
 		return ret;
 	}
 
+	if (drv_data->cts_dev) {
+		ret = wait_cts(dev);
+		if (ret < 0) {
+			LOG_ERR("CTS timeout exceeded");
+			return ret;
+		}
+
+		/* No response to read, CTS is all we were waiting for. */
+		if (rx_len == 0) {
+			return 0;
+		}
+	}
+
 	for (int retries = 0; retries < SI4362_CTS_TIMEOUT; retries++) {
 		ret = get_response(dev, rx_len, data_rx);
 		if (ret != -EAGAIN) {
@@ -210,30 +326,886 @@ static int transceive(const struct device *dev,
 	return -EIO;
 }
 
-int si4362_send_init_commands(const struct device *dev, const uint8_t *cmds)
+void si4362_stream_iter_init(struct si4362_stream_iter *iter,
+			     const struct si4362_stream *stream)
 {
-	const uint8_t *p = cmds;
-	int ret = 0;
+	iter->base = stream->base;
+	iter->delta = stream->delta;
+	iter->copy = 0;
+	iter->skip = 0;
+	iter->count = 0;
+}
+
+static const uint8_t *next_base(struct si4362_stream_iter *iter)
+{
+	const uint8_t *cmd = iter->base;
 
+	if (cmd == NULL || *cmd == 0) {
+		return NULL;
+	}
+
+	iter->base += *cmd + 1;
+	return cmd;
+}
+
+const uint8_t *si4362_stream_next(struct si4362_stream_iter *iter)
+{
 	for (;;) {
-		size_t cmd_len = *p++;
-		if (cmd_len == 0) {
-			break;
+		if (iter->copy > 0) {
+			iter->copy--;
+			return next_base(iter);
+		}
+
+		for (; iter->skip > 0; iter->skip--) {
+			next_base(iter);
+		}
+
+		if (iter->count > 0) {
+			const uint8_t *cmd = iter->delta;
+
+			iter->count--;
+			iter->delta += *cmd + 1;
+			return cmd;
+		}
+
+		if (iter->delta == NULL) {
+			return next_base(iter);
 		}
 
-		LOG_DBG("command: 0x%02x (len = %d)", (int)*p, (int)cmd_len);
+		const uint8_t *entry = iter->delta;
 
-		ret = transceive(dev, cmd_len, p, 0, NULL);
+		if (entry[0] == 0 && entry[1] == 0 && entry[2] == 0) {
+			iter->delta = NULL;
+			continue;
+		}
+
+		iter->copy = entry[0];
+		iter->skip = entry[1];
+		iter->count = entry[2];
+		iter->delta = entry + 3;
+	}
+}
+
+int si4362_send_init_commands(const struct device *dev,
+			      const struct si4362_stream *stream)
+{
+	struct si4362_stream_iter iter;
+	const uint8_t *cmd;
+
+	si4362_stream_iter_init(&iter, stream);
+
+	while ((cmd = si4362_stream_next(&iter)) != NULL) {
+		LOG_DBG("command: 0x%02x (len = %d)", (int)cmd[1], (int)cmd[0]);
+
+		int ret = transceive(dev, cmd[0], &cmd[1], 0, NULL);
 		if (ret < 0) {
 			return ret;
 		}
+	}
+
+	return 0;
+}
 
-		p += cmd_len;
+/* Send the next command of a cursor, if any. */
+static int init_step(struct si4362_init_cursor *cursor)
+{
+	struct si4362_drv_data *drv_data = cursor->dev->data;
+	const uint8_t *cmd;
+
+	for (;;) {
+		if (cursor->streams->base == NULL) {
+			return 0;
+		}
+
+		cmd = si4362_stream_next(&cursor->iter);
+		if (cmd != NULL) {
+			break;
+		}
+
+		cursor->streams++;
+		si4362_stream_iter_init(&cursor->iter, cursor->streams);
+	}
+
+	LOG_DBG("%s command: 0x%02x (len = %d)", cursor->dev->name,
+		(int)cmd[1], (int)cmd[0]);
+
+	k_sem_reset(&drv_data->cts_sem);
+
+	int ret = send_command(cursor->dev, cmd[0], &cmd[1]);
+	if (ret < 0) {
+		return ret;
+	}
+
+	cursor->busy = true;
+	return 0;
+}
+
+static int send_init_sequential(struct si4362_init_cursor *cursors,
+				size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		for (const struct si4362_stream *s = cursors[i].streams;
+		     s->base != NULL; s++) {
+			int ret = si4362_send_init_commands(cursors[i].dev, s);
+			if (ret < 0) {
+				return ret;
+			}
+		}
+	}
+
+	return 0;
+}
+
+int si4362_send_init_commands_parallel(struct si4362_init_cursor *cursors,
+				       size_t count)
+{
+	struct k_poll_event events[SI4362_INIT_MAX_DEVICES];
+	struct si4362_init_cursor *waiting[SI4362_INIT_MAX_DEVICES];
+
+	if (count > SI4362_INIT_MAX_DEVICES) {
+		return -EINVAL;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		struct si4362_drv_data *drv_data = cursors[i].dev->data;
+
+		if (!drv_data->cts_dev) {
+			return send_init_sequential(cursors, count);
+		}
+
+		si4362_stream_iter_init(&cursors[i].iter, cursors[i].streams);
+		cursors[i].busy = false;
+	}
+
+	for (;;) {
+		size_t num_events = 0;
+
+		for (size_t i = 0; i < count; i++) {
+			struct si4362_init_cursor *cursor = &cursors[i];
+			struct si4362_drv_data *drv_data = cursor->dev->data;
+
+			if (!cursor->busy) {
+				int ret = init_step(cursor);
+				if (ret < 0) {
+					return ret;
+				}
+			}
+
+			if (cursor->busy) {
+				k_poll_event_init(&events[num_events],
+						  K_POLL_TYPE_SEM_AVAILABLE,
+						  K_POLL_MODE_NOTIFY_ONLY,
+						  &drv_data->cts_sem);
+				waiting[num_events++] = cursor;
+			}
+		}
+
+		if (num_events == 0) {
+			return 0;
+		}
+
+		uint32_t start = k_cycle_get_32();
+		int ret = k_poll(events, num_events, SI4362_CTS_WAIT);
+		uint32_t elapsed = k_cycle_get_32() - start;
+
+		for (size_t i = 0; i < num_events; i++) {
+			struct si4362_init_cursor *cursor = waiting[i];
+			struct si4362_drv_data *drv_data = cursor->dev->data;
+
+			drv_data->stats.wait_cycles += elapsed;
+
+			if (k_sem_take(&drv_data->cts_sem, K_NO_WAIT) == 0) {
+				cursor->busy = false;
+			} else if (ret == -EAGAIN) {
+				/* Nothing for a whole timeout, check the levels. */
+				if (si4362_get_cts(cursor->dev) <= 0) {
+					LOG_ERR("%s: CTS timeout exceeded",
+						cursor->dev->name);
+					return -EIO;
+				}
+				cursor->busy = false;
+			}
+		}
+	}
+}
+
+int si4362_part_info(const struct device *dev, struct si4362_part_info *info)
+{
+	const uint8_t cmd = SI4362_CMD_PART_INFO;
+	uint8_t resp[8];
+
+	int ret = transceive(dev, sizeof(cmd), &cmd, sizeof(resp), resp);
+	if (ret < 0) {
+		return ret;
+	}
+
+	info->chip_rev = resp[0];
+	info->part = sys_get_be16(&resp[1]);
+	info->pbuild = resp[3];
+	info->id = sys_get_be16(&resp[4]);
+	info->customer = resp[6];
+	info->rom_id = resp[7];
+
+	return 0;
+}
+
+int si4362_get_temperature(const struct device *dev, int *celsius)
+{
+	const uint8_t cmd[] = {
+		SI4362_CMD_GET_ADC_READING, SI4362_ADC_TEMPERATURE, 0x00,
+	};
+	uint8_t resp[6];
+
+	int ret = transceive(dev, sizeof(cmd), cmd, sizeof(resp), resp);
+	if (ret < 0) {
+		return ret;
+	}
+
+	/* TEMP_ADC to degrees as given in the API documentation. */
+	*celsius = (899 * (int)sys_get_be16(&resp[4])) / 4096 - 293;
+
+	return 0;
+}
+
+int si4362_set_properties(const struct device *dev, uint8_t group,
+			  uint8_t start, const uint8_t *values, size_t count)
+{
+	uint8_t cmd[4 + SI4362_MAX_PROPERTIES] = {
+		SI4362_CMD_SET_PROPERTY, group, count, start,
+	};
+
+	if (count == 0 || count > SI4362_MAX_PROPERTIES) {
+		return -EINVAL;
+	}
+
+	memcpy(&cmd[4], values, count);
+
+	return transceive(dev, 4 + count, cmd, 0, NULL);
+}
+
+/* The VCO runs at 3.4-4.2 GHz, the output divider selects the band. */
+#define VCO_MIN_HZ 3400000000ULL
+#define VCO_MAX_HZ 4200000000ULL
+/* Prescaler of the high performance synthesizer, MODEM_CLKGEN_BAND.SY_SEL. */
+#define PLL_PRESCALER 2
+/* FREQ_CONTROL_FRAC is 20 bits with the top bit always set. */
+#define PLL_FRAC_BITS 19
+
+static const uint8_t output_dividers[] = { 4, 6, 8, 12, 16, 24 };
+
+int si4362_set_frequency(const struct device *dev, uint32_t hz)
+{
+	const struct si4362_config *config = dev->config;
+	const uint8_t start_rx[] = {
+		SI4362_CMD_START_RX, 0, 0, 0, 0, 0, 0, 0,
+	};
+	uint8_t outdiv = 0;
+
+	for (int i = 0; i < ARRAY_SIZE(output_dividers); i++) {
+		uint64_t vco = (uint64_t)hz * output_dividers[i];
+
+		if (vco >= VCO_MIN_HZ && vco <= VCO_MAX_HZ) {
+			outdiv = output_dividers[i];
+			break;
+		}
+	}
+
+	if (outdiv == 0) {
+		return -EINVAL;
+	}
+
+	/* Truncated like WDS does, so the configured values come back. */
+	uint64_t n = ((uint64_t)hz * outdiv << PLL_FRAC_BITS) /
+		     (PLL_PRESCALER * (uint64_t)config->xo_freq);
+	uint32_t inte = (n >> PLL_FRAC_BITS) - 1;
+	uint32_t frac = n - ((uint64_t)inte << PLL_FRAC_BITS);
+	const uint8_t values[] = {
+		inte, frac >> 16, frac >> 8, frac,
+	};
+
+	int ret = si4362_set_properties(dev, SI4362_PROP_GROUP_FREQ_CONTROL,
+					SI4362_PROP_FREQ_CONTROL_INTE, values,
+					sizeof(values));
+	if (ret < 0) {
+		return ret;
+	}
+
+	return transceive(dev, sizeof(start_rx), start_rx, 0, NULL);
+}
+
+int si4362_get_state(const struct device *dev, uint8_t *state)
+{
+	const uint8_t cmd = SI4362_CMD_REQUEST_DEVICE_STATE;
+	/* CURR_STATE and CURRENT_CHANNEL. */
+	uint8_t resp[2];
+
+	int ret = transceive(dev, sizeof(cmd), &cmd, sizeof(resp), resp);
+	if (ret < 0) {
+		return ret;
 	}
 
+	*state = resp[0] & SI4362_STATE_MASK;
 	return 0;
 }
 
+int si4362_get_rssi(const struct device *dev, uint8_t *rssi)
+{
+	/* Pending modem interrupts are left as they are. */
+	const uint8_t cmd[] = { SI4362_CMD_GET_MODEM_STATUS, 0xff };
+	/* MODEM_PEND, MODEM_STATUS and CURR_RSSI. */
+	uint8_t resp[3];
+	int ret;
+
+#ifdef CONFIG_SI4362_SCHED
+	if (((struct si4362_drv_data *)dev->data)->cts_dev) {
+		ret = sched_transceive(dev, SI4362_PRIO_URGENT, 0, sizeof(cmd),
+				       cmd, sizeof(resp), resp);
+	} else
+#endif
+	{
+		ret = transceive(dev, sizeof(cmd), cmd, sizeof(resp), resp);
+	}
+
+	if (ret < 0) {
+		return ret;
+	}
+
+	*rssi = resp[2];
+	return 0;
+}
+
+int si4362_ircal_manual(const struct device *dev, uint8_t amp, uint8_t ph,
+			uint8_t reply[2])
+{
+	const uint8_t cmd[] = { SI4362_CMD_IRCAL_MANUAL, amp, ph };
+
+	return transceive(dev, sizeof(cmd), cmd, 2, reply);
+}
+
+void si4362_get_stats(const struct device *dev, struct si4362_stats *stats)
+{
+	struct si4362_drv_data *drv_data = dev->data;
+
+	*stats = drv_data->stats;
+}
+
+#ifdef CONFIG_SI4362_SCHED
+enum xfer_phase {
+	XFER_COMMAND,
+	XFER_RESPONSE,
+};
+
+static sys_slist_t sched_queues[SI4362_PRIO_COUNT];
+static struct k_spinlock sched_lock;
+static K_SEM_DEFINE(sched_kick, 0, 1);
+
+/* Transactions waiting for CTS, at most one per radio. */
+static struct si4362_xfer *sched_waiting[SI4362_INIT_MAX_DEVICES];
+
+int si4362_submit(struct si4362_xfer *xfer)
+{
+	struct si4362_drv_data *drv_data = xfer->dev->data;
+
+	if (xfer->cmd_len == 0 || xfer->cmd_len > SI4362_XFER_MAX_LEN ||
+	    xfer->resp_len > SI4362_XFER_MAX_LEN ||
+	    xfer->prio >= SI4362_PRIO_COUNT) {
+		return -EINVAL;
+	}
+
+	/* Command and response are clocked in one bus transaction. */
+	if ((xfer->flags & SI4362_XFER_IMMEDIATE) &&
+	    xfer->cmd_len + xfer->resp_len > SI4362_XFER_MAX_BYTES) {
+		return -EINVAL;
+	}
+
+	if (!(xfer->flags & SI4362_XFER_IMMEDIATE) && !drv_data->cts_dev) {
+		return -ENOTSUP;
+	}
+
+	xfer->phase = XFER_COMMAND;
+
+	k_spinlock_key_t key = k_spin_lock(&sched_lock);
+	sys_slist_append(&sched_queues[xfer->prio], &xfer->node);
+	k_spin_unlock(&sched_lock, key);
+
+	k_sem_give(&sched_kick);
+	return 0;
+}
+
+uint32_t si4362_max_hold_us(const struct device *dev)
+{
+	struct si4362_drv_data *drv_data = dev->data;
+	uint64_t bits = SI4362_XFER_MAX_BYTES * 8;
+
+	/* Rounded up, plus the CS delay on both ends. */
+	uint32_t bit_us = (bits * USEC_PER_SEC +
+			   drv_data->spi_cfg.frequency - 1) /
+			  drv_data->spi_cfg.frequency +
+			  2 * drv_data->cs_ctrl.delay;
+	uint32_t byte_us = k_cyc_to_us_ceil32(
+		drv_data->stats.max_byte_cycles * SI4362_XFER_MAX_BYTES);
+
+	return MAX(bit_us, byte_us);
+}
+
+static void complete(struct si4362_xfer *xfer, int result)
+{
+	if (xfer->done != NULL) {
+		xfer->done(xfer, result);
+	} else {
+		k_poll_signal_raise(xfer->signal, result);
+	}
+}
+
+static bool xfer_ready(const struct si4362_xfer *xfer)
+{
+	const struct si4362_drv_data *drv_data = xfer->dev->data;
+
+	if (xfer->flags & SI4362_XFER_IMMEDIATE) {
+		return true;
+	}
+
+	/* Only one command can be in the radio at a time. */
+	return drv_data->sched_owner == NULL || drv_data->sched_owner == xfer;
+}
+
+static bool earlier(const struct si4362_xfer *a, const struct si4362_xfer *b)
+{
+	if (a->deadline == 0) {
+		return false;
+	}
+
+	return b->deadline == 0 || a->deadline < b->deadline;
+}
+
+static bool device_seen(const struct device *const *seen, size_t num_seen,
+			const struct device *dev)
+{
+	for (size_t i = 0; i < num_seen; i++) {
+		if (seen[i] == dev) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Take the next transaction to run off the queues. Transactions that
+ * missed their deadline are moved to expired. Sets *next_deadline to the
+ * earliest deadline left in the queues, or 0.
+ */
+static struct si4362_xfer *sched_pick(sys_slist_t *expired,
+				      int64_t *next_deadline)
+{
+	int64_t now = k_uptime_get();
+	struct si4362_xfer *best = NULL;
+	sys_snode_t *best_prev = NULL;
+	int best_prio = 0;
+
+	*next_deadline = 0;
+
+	k_spinlock_key_t key = k_spin_lock(&sched_lock);
+
+	for (int prio = 0; prio < SI4362_PRIO_COUNT; prio++) {
+		/* Commands to a radio keep their order within a priority. */
+		const struct device *seen[SI4362_INIT_MAX_DEVICES];
+		size_t num_seen = 0;
+		sys_snode_t *prev = NULL;
+		sys_snode_t *node;
+		sys_snode_t *next;
+
+		SYS_SLIST_FOR_EACH_NODE_SAFE(&sched_queues[prio], node, next) {
+			struct si4362_xfer *xfer =
+				CONTAINER_OF(node, struct si4362_xfer, node);
+
+			if (xfer->phase == XFER_COMMAND && xfer->deadline != 0 &&
+			    xfer->deadline <= now) {
+				sys_slist_remove(&sched_queues[prio], prev, node);
+				sys_slist_append(expired, node);
+				continue;
+			}
+
+			if (xfer->deadline != 0 &&
+			    (*next_deadline == 0 ||
+			     xfer->deadline < *next_deadline)) {
+				*next_deadline = xfer->deadline;
+			}
+
+			sys_snode_t *xfer_prev = prev;
+
+			prev = node;
+
+			if (!(xfer->flags & SI4362_XFER_IMMEDIATE)) {
+				if (device_seen(seen, num_seen, xfer->dev)) {
+					continue;
+				}
+				if (num_seen < ARRAY_SIZE(seen)) {
+					seen[num_seen++] = xfer->dev;
+				}
+			}
+
+			if (best == NULL && xfer_ready(xfer)) {
+				best = xfer;
+				best_prev = xfer_prev;
+				best_prio = prio;
+			} else if (best != NULL && best_prio == prio &&
+				   xfer_ready(xfer) && earlier(xfer, best)) {
+				best = xfer;
+				best_prev = xfer_prev;
+			}
+		}
+	}
+
+	if (best != NULL) {
+		sys_slist_remove(&sched_queues[best_prio], best_prev,
+				 &best->node);
+	}
+
+	k_spin_unlock(&sched_lock, key);
+
+	return best;
+}
+
+/* Run identical queued reads of the same radio with this one. */
+static void sched_run_immediate(struct si4362_xfer *xfer)
+{
+	sys_slist_t batch;
+	uint8_t resp[SI4362_XFER_MAX_LEN];
+	uint8_t resp_len = xfer->resp_len;
+
+	sys_slist_init(&batch);
+
+	k_spinlock_key_t key = k_spin_lock(&sched_lock);
+
+	for (int prio = 0; prio < SI4362_PRIO_COUNT; prio++) {
+		sys_snode_t *prev = NULL;
+		sys_snode_t *node;
+		sys_snode_t *next;
+
+		SYS_SLIST_FOR_EACH_NODE_SAFE(&sched_queues[prio], node, next) {
+			struct si4362_xfer *other =
+				CONTAINER_OF(node, struct si4362_xfer, node);
+
+			if (other->dev == xfer->dev &&
+			    (other->flags & SI4362_XFER_IMMEDIATE) &&
+			    other->cmd_len == xfer->cmd_len &&
+			    memcmp(other->cmd, xfer->cmd, xfer->cmd_len) == 0) {
+				sys_slist_remove(&sched_queues[prio], prev, node);
+				sys_slist_append(&batch, node);
+				resp_len = MAX(resp_len, other->resp_len);
+				continue;
+			}
+
+			prev = node;
+		}
+	}
+
+	k_spin_unlock(&sched_lock, key);
+
+	int ret = read_immediate(xfer->dev, xfer->cmd_len, xfer->cmd,
+				 resp_len, resp);
+
+	sys_slist_prepend(&batch, &xfer->node);
+
+	sys_snode_t *node;
+
+	while ((node = sys_slist_get(&batch)) != NULL) {
+		struct si4362_xfer *done =
+			CONTAINER_OF(node, struct si4362_xfer, node);
+
+		memcpy(done->resp, resp, done->resp_len);
+		complete(done, ret);
+	}
+}
+
+static void sched_wait_cts(struct si4362_xfer *xfer)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(sched_waiting); i++) {
+		if (sched_waiting[i] == NULL) {
+			sched_waiting[i] = xfer;
+			return;
+		}
+	}
+
+	/* One slot per radio, there is always room. */
+	__ASSERT_NO_MSG(false);
+}
+
+static void sched_run(struct si4362_xfer *xfer)
+{
+	struct si4362_drv_data *drv_data = xfer->dev->data;
+	int ret;
+
+	if (xfer->flags & SI4362_XFER_IMMEDIATE) {
+		sched_run_immediate(xfer);
+		return;
+	}
+
+	if (xfer->phase == XFER_RESPONSE) {
+		ret = get_response(xfer->dev, xfer->resp_len, xfer->resp);
+		drv_data->sched_owner = NULL;
+		complete(xfer, ret == -EAGAIN ? -EIO : ret);
+		return;
+	}
+
+	drv_data->sched_owner = xfer;
+	k_sem_reset(&drv_data->cts_sem);
+
+	ret = send_command(xfer->dev, xfer->cmd_len, xfer->cmd);
+	if (ret < 0) {
+		drv_data->sched_owner = NULL;
+		complete(xfer, ret);
+		return;
+	}
+
+	xfer->sent = k_cycle_get_32();
+	sched_wait_cts(xfer);
+}
+
+/*
+ * Move the transactions whose radio reported CTS on: complete them, or
+ * queue the response read in front of their priority.
+ */
+static void sched_collect_cts(void)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(sched_waiting); i++) {
+		struct si4362_xfer *xfer = sched_waiting[i];
+
+		if (xfer == NULL) {
+			continue;
+		}
+
+		struct si4362_drv_data *drv_data = xfer->dev->data;
+		uint32_t waited = k_cycle_get_32() - xfer->sent;
+		int ret = 0;
+
+		if (k_sem_take(&drv_data->cts_sem, K_NO_WAIT) != 0) {
+			if (waited < k_ms_to_cyc_ceil32(SI4362_CTS_WAIT_MS)) {
+				continue;
+			}
+
+			/* Missed edge, or the radio is stuck. */
+			if (si4362_get_cts(xfer->dev) <= 0) {
+				LOG_ERR("%s: CTS timeout exceeded",
+					xfer->dev->name);
+				ret = -EIO;
+			}
+		}
+
+		sched_waiting[i] = NULL;
+		drv_data->stats.wait_cycles += waited;
+
+		if (ret == 0 && xfer->resp_len > 0) {
+			xfer->phase = XFER_RESPONSE;
+
+			k_spinlock_key_t key = k_spin_lock(&sched_lock);
+			sys_slist_prepend(&sched_queues[xfer->prio], &xfer->node);
+			k_spin_unlock(&sched_lock, key);
+			continue;
+		}
+
+		drv_data->sched_owner = NULL;
+		complete(xfer, ret);
+	}
+}
+
+static void sched_wait(int64_t next_deadline)
+{
+	struct k_poll_event events[1 + ARRAY_SIZE(sched_waiting)];
+	int64_t wait_ms = -1;
+	int num_events = 0;
+
+	k_poll_event_init(&events[num_events++], K_POLL_TYPE_SEM_AVAILABLE,
+			  K_POLL_MODE_NOTIFY_ONLY, &sched_kick);
+
+	for (size_t i = 0; i < ARRAY_SIZE(sched_waiting); i++) {
+		struct si4362_xfer *xfer = sched_waiting[i];
+
+		if (xfer == NULL) {
+			continue;
+		}
+
+		struct si4362_drv_data *drv_data = xfer->dev->data;
+
+		k_poll_event_init(&events[num_events++],
+				  K_POLL_TYPE_SEM_AVAILABLE,
+				  K_POLL_MODE_NOTIFY_ONLY, &drv_data->cts_sem);
+		wait_ms = SI4362_CTS_WAIT_MS;
+	}
+
+	if (next_deadline != 0) {
+		int64_t left = MAX(next_deadline - k_uptime_get(), 0);
+
+		if (wait_ms < 0 || left < wait_ms) {
+			wait_ms = left;
+		}
+	}
+
+	k_poll(events, num_events, wait_ms < 0 ? K_FOREVER : K_MSEC(wait_ms));
+	k_sem_take(&sched_kick, K_NO_WAIT);
+}
+
+static void sched_thread(void *p1, void *p2, void *p3)
+{
+	sys_slist_t expired;
+	int64_t next_deadline;
+
+	sys_slist_init(&expired);
+
+	for (;;) {
+		sched_collect_cts();
+
+		struct si4362_xfer *xfer = sched_pick(&expired, &next_deadline);
+		sys_snode_t *node;
+
+		while ((node = sys_slist_get(&expired)) != NULL) {
+			complete(CONTAINER_OF(node, struct si4362_xfer, node),
+				 -ETIMEDOUT);
+		}
+
+		if (xfer != NULL) {
+			sched_run(xfer);
+			continue;
+		}
+
+		sched_wait(next_deadline);
+	}
+}
+
+/* Next command of an upload, or NULL after the last stream. */
+static const uint8_t *upload_next(struct si4362_upload *upload)
+{
+	const uint8_t *cmd;
+
+	while ((cmd = si4362_stream_next(&upload->iter)) == NULL) {
+		upload->streams++;
+		if (upload->streams->base == NULL) {
+			return NULL;
+		}
+
+		si4362_stream_iter_init(&upload->iter, upload->streams);
+	}
+
+	return cmd;
+}
+
+static void upload_finish(struct si4362_upload *upload, int result)
+{
+	upload->done_cycles = k_cycle_get_32();
+	k_poll_signal_raise(upload->signal, result);
+}
+
+static void upload_done(struct si4362_xfer *xfer, int result);
+
+/* Queue the next command, -ENODATA if there is none. */
+static int upload_step(struct si4362_upload *upload)
+{
+	const uint8_t *cmd = upload_next(upload);
+
+	if (cmd == NULL) {
+		return -ENODATA;
+	}
+
+	LOG_DBG("%s command: 0x%02x (len = %d)", upload->dev->name,
+		(int)cmd[1], (int)cmd[0]);
+
+	upload->xfer = (struct si4362_xfer){
+		.dev = upload->dev,
+		.cmd = &cmd[1],
+		.cmd_len = cmd[0],
+		.prio = upload->prio,
+		.done = upload_done,
+	};
+
+	return si4362_submit(&upload->xfer);
+}
+
+static void upload_done(struct si4362_xfer *xfer, int result)
+{
+	struct si4362_upload *upload =
+		CONTAINER_OF(xfer, struct si4362_upload, xfer);
+
+	if (result == 0) {
+		result = upload_step(upload);
+		if (result == 0) {
+			return;
+		}
+	}
+
+	upload_finish(upload, result == -ENODATA ? 0 : result);
+}
+
+int si4362_send_commands_async(struct si4362_upload *upload)
+{
+	struct si4362_drv_data *drv_data = upload->dev->data;
+	int ret = -ENODATA;
+
+	if (!drv_data->cts_dev) {
+		/* Polled for CTS like transceive() does, one after the other. */
+		ret = 0;
+
+		while (ret == 0 && upload->streams->base != NULL) {
+			ret = si4362_send_init_commands(upload->dev,
+							upload->streams);
+			upload->streams++;
+		}
+
+		upload_finish(upload, ret);
+		return 0;
+	}
+
+	if (upload->streams->base != NULL) {
+		si4362_stream_iter_init(&upload->iter, upload->streams);
+		ret = upload_step(upload);
+	}
+
+	if (ret == -ENODATA) {
+		upload_finish(upload, 0);
+		return 0;
+	}
+
+	return ret;
+}
+
+K_THREAD_DEFINE(si4362_sched, CONFIG_SI4362_SCHED_STACK_SIZE, sched_thread,
+		NULL, NULL, NULL, CONFIG_SI4362_SCHED_PRIORITY, 0, 0);
+
+static int sched_transceive(const struct device *dev, enum si4362_prio prio,
+			    uint8_t flags, size_t tx_len, const void *data_tx,
+			    size_t rx_len, void *data_rx)
+{
+	struct k_poll_signal signal;
+	struct k_poll_event event;
+	struct si4362_xfer xfer = {
+		.dev = dev,
+		.cmd = data_tx,
+		.cmd_len = tx_len,
+		.resp = data_rx,
+		.resp_len = rx_len,
+		.flags = flags,
+		.prio = prio,
+		.signal = &signal,
+	};
+	unsigned int signaled;
+	int result;
+
+	k_poll_signal_init(&signal);
+	k_poll_event_init(&event, K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY,
+			  &signal);
+
+	int ret = si4362_submit(&xfer);
+	if (ret < 0) {
+		return ret;
+	}
+
+	k_poll(&event, 1, K_FOREVER);
+	k_poll_signal_check(&signal, &signaled, &result);
+
+	return result;
+}
+#endif
+
 #define CONFIGURE_PIN(name, extra_flags)					\
 ({if (config->name.dev) {							\
 	drv_data->name##_dev = device_get_binding(config->name.dev);		\
@@ -310,6 +1282,20 @@ static int si4362_init(const struct device *dev)
 			&drv_data->rx_clock_cb);
 	}
 
+	if (drv_data->cts_dev) {
+		k_sem_init(&drv_data->cts_sem, 0, 1);
+		gpio_init_callback(&drv_data->cts_cb, &cts_callback_handler,
+			BIT(config->cts.pin));
+		gpio_add_callback(drv_data->cts_dev, &drv_data->cts_cb);
+
+		int ret = gpio_pin_interrupt_configure(drv_data->cts_dev,
+			config->cts.pin, GPIO_INT_ENABLE | GPIO_INT_EDGE_RISING);
+		if (ret < 0) {
+			LOG_ERR("Unable to configure CTS interrupt: %d", ret);
+			return ret;
+		}
+	}
+
 	si4362_reset(dev);
 
 	return 0;
@@ -328,6 +1314,7 @@ static int si4362_init(const struct device *dev)
 		.spi_dev_name = DT_INST_BUS_LABEL(inst),			\
 		.slave = DT_INST_REG_ADDR(inst),				\
 		.freq = DT_INST_PROP(inst, spi_max_frequency),			\
+		.xo_freq = DT_INST_PROP(inst, clock_frequency),			\
 										\
 		IF_ENABLED(DT_INST_SPI_DEV_HAS_CS_GPIOS(inst),			\
 			(.cs = {						\
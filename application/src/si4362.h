@@ -24,10 +24,29 @@ struct si4362_gpio_pin_config {
 	gpio_dt_flags_t flags;
 };
 
+/** Command statistics, times in hardware cycles. */
+struct si4362_stats {
+	uint32_t commands;
+	/** SPI transactions including response reads. */
+	uint32_t transactions;
+	/** Time the shared SPI bus was held. */
+	uint64_t bus_cycles;
+	/** Time spent waiting for CTS with the bus released. */
+	uint64_t wait_cycles;
+	/** Longest single transaction. */
+	uint32_t max_hold_cycles;
+	/** Longest transaction divided by its length in bytes. */
+	uint32_t max_byte_cycles;
+};
+
+struct si4362_xfer;
+
 struct si4362_config {
 	const char *spi_dev_name;
 	uint16_t slave;
 	uint32_t freq;
+	/** Crystal or TCXO frequency in Hz. */
+	uint32_t xo_freq;
 	struct si4362_gpio_pin_config cs;
 	struct si4362_gpio_pin_config sdn;
 	struct si4362_gpio_pin_config irq;
@@ -53,12 +72,50 @@ struct si4362_drv_data {
 
 	struct gpio_callback rx_clock_cb;
 	si4362_rx_callback rx_callback;
+
+	/* Given on the rising edge of CTS. */
+	struct gpio_callback cts_cb;
+	struct k_sem cts_sem;
+
+	struct si4362_stats stats;
+
+#ifdef CONFIG_SI4362_SCHED
+	/* Scheduled transaction whose command is in the radio. */
+	struct si4362_xfer *sched_owner;
+#endif
 };
 
 #define SI4362_CMD_NOP       0x00
 #define SI4362_CMD_PART_INFO 0x01
 #define SI4362_CMD_POWER_UP  0x02
 #define SI4362_CMD_FUNC_INFO 0x10
+#define SI4362_CMD_GET_ADC_READING 0x14
+#define SI4362_CMD_IRCAL 0x17
+#define SI4362_CMD_IRCAL_MANUAL 0x19
+#define SI4362_CMD_GET_MODEM_STATUS 0x22
+#define SI4362_CMD_START_RX 0x32
+#define SI4362_CMD_SET_PROPERTY 0x11
+#define SI4362_CMD_FRR_A_READ 0x50
+#define SI4362_CMD_FRR_B_READ 0x51
+#define SI4362_CMD_REQUEST_DEVICE_STATE 0x33
+
+/* Low nibble of the state reported by REQUEST_DEVICE_STATE and the FRR. */
+#define SI4362_STATE_MASK 0x0f
+#define SI4362_STATE_RX_TUNE 6
+#define SI4362_STATE_RX 8
+
+/* Properties fitting in one SET_PROPERTY command. */
+#define SI4362_MAX_PROPERTIES 12
+
+#define SI4362_PROP_GROUP_FRR_CTL 0x02
+#define SI4362_PROP_FRR_CTL_B_MODE 0x01
+#define SI4362_FRR_MODE_CURRENT_STATE 0x09
+
+#define SI4362_PROP_GROUP_FREQ_CONTROL 0x40
+#define SI4362_PROP_FREQ_CONTROL_INTE 0x00
+
+/* GET_ADC_READING argument selecting the temperature sensor. */
+#define SI4362_ADC_TEMPERATURE 0x10
 
 struct si4362_part_info {
 	uint8_t chip_rev;
@@ -82,9 +139,226 @@ int si4362_get_cts(const struct device *dev);
 int si4362_configure_interrupt(const struct device *dev, bool enable);
 void si4362_set_callback(const struct device *dev, si4362_rx_callback callback);
 
-int si4362_send_init_commands(const struct device *dev, const uint8_t *cmds);
+/**
+ * Init command stream, optionally stored as a delta against another one.
+ *
+ * Commands are length prefixed, a zero length ends the stream. A delta is
+ * a list of entries, each is:
+ *
+ *   u8 number of base commands to send
+ *   u8 number of base commands to leave out after them
+ *   u8 number of commands that follow, sent instead
+ *   commands, length prefixed
+ *
+ * and an entry of three zero bytes ends the delta. The remaining base
+ * commands are sent after the last entry.
+ */
+struct si4362_stream {
+	const uint8_t *base;
+	/** Delta against base, or NULL. */
+	const uint8_t *delta;
+};
+
+/** Position in a stream with its delta applied. */
+struct si4362_stream_iter {
+	const uint8_t *base;
+	const uint8_t *delta;
+	uint8_t copy;
+	uint8_t skip;
+	uint8_t count;
+};
+
+void si4362_stream_iter_init(struct si4362_stream_iter *iter,
+			     const struct si4362_stream *stream);
+
+/** Return the next command, length prefixed, or NULL at the end. */
+const uint8_t *si4362_stream_next(struct si4362_stream_iter *iter);
+
+int si4362_send_init_commands(const struct device *dev,
+			      const struct si4362_stream *stream);
+
+/** Maximum number of radios initialized together. */
+#define SI4362_INIT_MAX_DEVICES 4
+
+/** Position of a radio in its init command streams. */
+struct si4362_init_cursor {
+	const struct device *dev;
+	/** Command streams, terminated by one with a NULL base. */
+	const struct si4362_stream *streams;
+
+	/* Private, set up by si4362_send_init_commands_parallel(). */
+	struct si4362_stream_iter iter;
+	bool busy;
+};
+
+/**
+ * Send init command streams to several radios at once.
+ *
+ * A command is sent to every radio that reported CTS, so commands run on
+ * all radios in parallel and the shared bus is only used for the command
+ * bytes. Falls back to one radio after the other if a radio has no CTS
+ * pin.
+ *
+ * This drives the bus directly, no transactions may be scheduled for the
+ * radios while it runs.
+ */
+int si4362_send_init_commands_parallel(struct si4362_init_cursor *cursors,
+				       size_t count);
+
+void si4362_get_stats(const struct device *dev, struct si4362_stats *stats);
+
+/** Transaction priorities, lower values run first. */
+enum si4362_prio {
+	/** Time critical reads such as fast response registers. */
+	SI4362_PRIO_URGENT,
+	SI4362_PRIO_NORMAL,
+	/** Monitoring and other background traffic. */
+	SI4362_PRIO_LOW,
+	SI4362_PRIO_COUNT,
+};
+
+/** Longest command or response of a scheduled transaction. */
+#define SI4362_XFER_MAX_LEN 16
+
+/*
+ * Longest bus transaction of the scheduler, a response read is
+ * READ_CMD_BUFF, CTS and the response. Immediate transactions clock the
+ * command and the response together and are limited to the same length.
+ */
+#define SI4362_XFER_MAX_BYTES (2 + SI4362_XFER_MAX_LEN)
+
+/*
+ * The response is clocked out right after the command without waiting
+ * for CTS, as for the FRR read commands. Identical queued reads of a radio
+ * are done in one transaction.
+ */
+#define SI4362_XFER_IMMEDIATE BIT(0)
+
+/**
+ * Transaction queued with si4362_submit().
+ *
+ * The scheduler thread owns the bus. It runs the ready transaction with
+ * the highest priority and, within a priority, the earliest deadline.
+ * A command is sent in one bus transaction and its response read in
+ * another after the CTS interrupt, the bus is free for the other radios
+ * in between. No transaction clocks more than SI4362_XFER_MAX_BYTES,
+ * whatever a radio is doing, see si4362_max_hold_us() for the time.
+ */
+struct si4362_xfer {
+	const struct device *dev;
+	const uint8_t *cmd;
+	uint8_t cmd_len;
+	uint8_t *resp;
+	uint8_t resp_len;
+	uint8_t flags;
+	enum si4362_prio prio;
+	/**
+	 * Uptime in ms the command must be sent by, 0 for none. Transactions
+	 * not started in time complete with -ETIMEDOUT.
+	 */
+	int64_t deadline;
+	/** Raised with the result when the transaction is complete. */
+	struct k_poll_signal *signal;
+
+	/* Private, used by the scheduler. */
+	sys_snode_t node;
+	uint8_t phase;
+	uint32_t sent;
+	/* Called in the scheduler thread instead of raising the signal. */
+	void (*done)(struct si4362_xfer *xfer, int result);
+};
+
+/**
+ * Queue a transaction. The buffers must stay valid until the signal is
+ * raised.
+ *
+ * @return 0 on success, -EINVAL for bad lengths, -ENOTSUP if the radio
+ *         has no CTS pin and the transaction needs one.
+ */
+int si4362_submit(struct si4362_xfer *xfer);
+
+/**
+ * Estimated upper bound of the time a scheduled transaction holds the bus.
+ *
+ * This is SI4362_XFER_MAX_BYTES at the slowest cost per byte measured so
+ * far, which includes the transaction setup and, with an interrupt driven
+ * SPI driver, the per-byte interrupts. Before any transaction it is the
+ * bit time at the bus frequency only. It is not a guarantee, a
+ * transaction can still be stretched by higher priority interrupts.
+ */
+uint32_t si4362_max_hold_us(const struct device *dev);
+
+/** Command upload started with si4362_send_commands_async(). */
+struct si4362_upload {
+	const struct device *dev;
+	/**
+	 * Command streams, terminated by one with a NULL base. Advanced as
+	 * the streams are sent.
+	 */
+	const struct si4362_stream *streams;
+	enum si4362_prio prio;
+	/** Raised with the result after the last command or an error. */
+	struct k_poll_signal *signal;
+	/** Cycle counter when the upload completed, valid once raised. */
+	uint32_t done_cycles;
+
+	/* Private, used by the scheduler. */
+	struct si4362_stream_iter iter;
+	struct si4362_xfer xfer;
+};
+
+/**
+ * Send command streams in the background.
+ *
+ * The scheduler queues the next command of an upload when the previous
+ * one completes, so the calling thread goes on right away and uploads to
+ * several radios run in parallel like with
+ * si4362_send_init_commands_parallel(). The upload and the streams must
+ * stay valid until the signal is raised.
+ *
+ * A radio without a CTS pin cannot be scheduled, its commands are sent
+ * before this returns and the signal is raised right away.
+ *
+ * @return 0 if the upload started or was done.
+ */
+int si4362_send_commands_async(struct si4362_upload *upload);
+
+/** Read the die temperature in degrees Celsius, the radio must be up. */
+int si4362_get_temperature(const struct device *dev, int *celsius);
+
+/**
+ * Send IRCAL_MANUAL. The reply carries the image rejection calibration
+ * values in use before the command.
+ *
+ * @param amp IRCAL_AMP argument, bit 7 (IRCAL_AMP_SKIP) keeps the value.
+ * @param ph IRCAL_PH argument, bit 7 (IRCAL_PH_SKIP) keeps the value.
+ * @param reply Two bytes, IRCAL_AMP_REPLY and IRCAL_PH_REPLY.
+ */
+int si4362_ircal_manual(const struct device *dev, uint8_t amp, uint8_t ph,
+			uint8_t reply[2]);
+
+/** Set up to SI4362_MAX_PROPERTIES consecutive properties of a group. */
+int si4362_set_properties(const struct device *dev, uint8_t group,
+			  uint8_t start, const uint8_t *values, size_t count);
+
+/** Read CURR_RSSI with GET_MODEM_STATUS, ahead of other scheduled traffic. */
+int si4362_get_rssi(const struct device *dev, uint8_t *rssi);
+
+/**
+ * Retune a receiving radio. Only the FREQ_CONTROL_INTE and FRAC
+ * properties are written and RX is started again, the rest of the
+ * configuration is kept. The frequency must be in the band of the
+ * configuration, 142-175 MHz for the marine VHF band, as the PLL output
+ * divider is not changed.
+ *
+ * Returns once START_RX is accepted, the radio is in RX_TUNE or RX then.
+ */
+int si4362_set_frequency(const struct device *dev, uint32_t hz);
+
+/** Read the state with REQUEST_DEVICE_STATE, SI4362_STATE_* values. */
+int si4362_get_state(const struct device *dev, uint8_t *state);
 
-// int si4362_part_info(const struct device *dev, struct si4362_part_info *info);
+int si4362_part_info(const struct device *dev, struct si4362_part_info *info);
 // int si4362_func_info(const struct device *dev, struct si4362_func_info *info);
 
 #ifdef __cplusplus
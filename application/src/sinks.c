@@ -0,0 +1,345 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <drivers/uart.h>
+#include <sys/ring_buffer.h>
+#include <shell/shell.h>
+
+#include "ais_binary.h"
+#include "flash_log.h"
+#include "nmea.h"
+#include "output.h"
+#include "sinks.h"
+#include "streams.h"
+#include "targets.h"
+
+#define LOG_LEVEL CONFIG_LOG_DEFAULT_LEVEL
+#include <logging/log.h>
+LOG_MODULE_REGISTER(sinks);
+
+#define SINK_STACK_SIZE 1024
+#define SINK_WRITE_TIMEOUT K_SECONDS(1)
+
+struct nmea_sink_ctx {
+	struct nmea_encoder nmea;
+	/** Stream for AIS 1, AIS 2 follows if per_channel is set. */
+	enum stream_id stream;
+	bool per_channel;
+};
+
+struct sentence_dest {
+	enum stream_id stream;
+};
+
+static void write_sentence(const char *sentence, size_t len, void *user_data)
+{
+	const struct sentence_dest *dest = user_data;
+
+	stream_write(dest->stream, sentence, len, SINK_WRITE_TIMEOUT);
+}
+
+static void nmea_sink_write(struct output_sink *sink,
+			    const struct ais_frame *frame)
+{
+	struct nmea_sink_ctx *ctx = sink->user_data;
+	struct sentence_dest dest = {
+		.stream = ctx->stream,
+	};
+
+	if (ctx->per_channel) {
+		dest.stream += frame->channel;
+	}
+
+	nmea_encode(&ctx->nmea, frame, write_sentence, &dest);
+}
+
+static void nmea_sink_handler(struct output_sink *sink,
+			      const struct output_packet *pkt)
+{
+	nmea_sink_write(sink, &pkt->frame);
+}
+
+static void binary_sink_write(struct output_sink *sink,
+			      const struct ais_frame *frame)
+{
+	static uint8_t buf[AIS_BINARY_MAX_LENGTH];
+	size_t len = ais_binary_encode(frame, buf);
+
+	stream_write(STREAM_AIS_A + frame->channel, buf, len,
+		     SINK_WRITE_TIMEOUT);
+}
+
+static void usb_sink_write(struct output_sink *sink,
+			   const struct ais_frame *frame)
+{
+	if (IS_ENABLED(CONFIG_APP_OUTPUT_BINARY)) {
+		binary_sink_write(sink, frame);
+	} else {
+		nmea_sink_write(sink, frame);
+	}
+}
+
+#ifdef CONFIG_APP_HOST_PULL
+/*
+ * Frames received while no host reads the port are kept unformatted, the
+ * oldest ones are dropped when the backlog is full.
+ */
+struct backlog_record {
+	uint64_t time_us;
+	uint16_t fcs;
+	uint8_t len;
+	uint8_t channel;
+	uint8_t flags;
+	int8_t quality;
+};
+
+RING_BUF_DECLARE(backlog, CONFIG_APP_HOST_PULL_BACKLOG_SIZE);
+static uint32_t backlog_stored;
+static uint32_t backlog_dropped;
+static uint32_t backlog_drained;
+
+static bool backlog_get(struct backlog_record *rec, uint8_t *data)
+{
+	if (ring_buf_get(&backlog, (uint8_t *)rec, sizeof(*rec)) == 0) {
+		return false;
+	}
+
+	ring_buf_get(&backlog, data, rec->len);
+
+	return true;
+}
+
+static void backlog_put(const struct ais_frame *frame)
+{
+	const struct backlog_record rec = {
+		.time_us = frame->time_us,
+		.fcs = frame->fcs,
+		.len = frame->len,
+		.channel = frame->channel,
+		.flags = frame->flags,
+		.quality = frame->quality,
+	};
+	size_t size = sizeof(rec) + rec.len;
+
+	if (size > ring_buf_capacity_get(&backlog)) {
+		return;
+	}
+
+	while (ring_buf_space_get(&backlog) < size) {
+		struct backlog_record old;
+		uint8_t discard[OUTPUT_MAX_PAYLOAD];
+
+		backlog_get(&old, discard);
+		backlog_dropped++;
+	}
+
+	ring_buf_put(&backlog, (const uint8_t *)&rec, sizeof(rec));
+	ring_buf_put(&backlog, frame->data, rec.len);
+	backlog_stored++;
+}
+
+static bool host_present(uint8_t channel)
+{
+	return stream_host_present(STREAM_AIS_A + channel);
+}
+
+static bool backlog_ready(bool requested)
+{
+	return requested || (host_present(0) && host_present(1));
+}
+
+/*
+ * Format and send the backlog once a host reads both channels, or once on
+ * request.
+ */
+static void backlog_drain(struct output_sink *sink)
+{
+	bool requested = stream_take_request(STREAM_AIS_A) |
+			 stream_take_request(STREAM_AIS_B);
+	struct backlog_record rec;
+	uint8_t data[OUTPUT_MAX_PAYLOAD + 1];
+
+	while (backlog_ready(requested) && backlog_get(&rec, data)) {
+		const struct ais_frame frame = {
+			.time_us = rec.time_us,
+			.data = data,
+			.fcs = rec.fcs,
+			.len = rec.len,
+			.channel = rec.channel,
+			.flags = rec.flags,
+			.quality = rec.quality,
+		};
+
+		/* The 6 bit encoder reads one byte past the payload. */
+		data[rec.len] = 0;
+		usb_sink_write(sink, &frame);
+		backlog_drained++;
+	}
+}
+
+static void usb_sink_handler(struct output_sink *sink,
+			     const struct output_packet *pkt)
+{
+	if (!host_present(pkt->frame.channel)) {
+		backlog_put(&pkt->frame);
+		return;
+	}
+
+	backlog_drain(sink);
+	usb_sink_write(sink, &pkt->frame);
+}
+#else
+static void usb_sink_handler(struct output_sink *sink,
+			     const struct output_packet *pkt)
+{
+	usb_sink_write(sink, &pkt->frame);
+}
+#endif
+
+static struct nmea_sink_ctx usb_ctx = {
+	.stream = STREAM_AIS_A,
+	.per_channel = true,
+};
+
+OUTPUT_SINK_DEFINE(usb_sink, usb_sink_handler, OUTPUT_DROP_OLDEST, 8,
+		   SINK_STACK_SIZE, 5, &usb_ctx);
+
+#ifdef CONFIG_APP_SINK_UART
+static struct nmea_sink_ctx uart_ctx = {
+	.stream = STREAM_UART,
+};
+
+/* A chart plotter cares about recent positions, drop stale data first. */
+OUTPUT_SINK_DEFINE(uart_sink, nmea_sink_handler, OUTPUT_DROP_OLDEST, 4,
+		   SINK_STACK_SIZE, 6, &uart_ctx);
+#endif
+
+#ifdef CONFIG_APP_SINK_DIAG
+static void diag_sink_handler(struct output_sink *sink,
+			      const struct output_packet *pkt)
+{
+	const struct ais_frame *frame = &pkt->frame;
+
+	LOG_INF("ch: %c, len: %u, time: %u ms", 'A' + frame->channel,
+		frame->len, (uint32_t)(frame->time_us / USEC_PER_MSEC));
+	LOG_HEXDUMP_DBG(frame->data, frame->len, "payload:");
+}
+
+OUTPUT_SINK_DEFINE(diag_sink, diag_sink_handler, OUTPUT_DROP_NEWEST, 4,
+		   SINK_STACK_SIZE, 10, NULL);
+#endif
+
+#ifdef CONFIG_APP_TARGETS
+static void targets_sink_handler(struct output_sink *sink,
+				 const struct output_packet *pkt)
+{
+	targets_update(&pkt->frame);
+}
+
+OUTPUT_SINK_DEFINE(targets_sink, targets_sink_handler, OUTPUT_DROP_OLDEST, 8,
+		   SINK_STACK_SIZE, 8, NULL);
+#endif
+
+#ifdef CONFIG_APP_FLASH_LOG
+static void flash_log_sink_handler(struct output_sink *sink,
+				   const struct output_packet *pkt)
+{
+	flash_log_append(&pkt->frame);
+}
+
+static void flash_log_sink_idle(struct output_sink *sink)
+{
+	flash_log_poll();
+}
+
+/* Page writes stall for tens of ms, the queue covers one of them. */
+OUTPUT_SINK_DEFINE(flash_log_sink, flash_log_sink_handler, OUTPUT_DROP_OLDEST,
+		   8, SINK_STACK_SIZE, 9, NULL);
+#endif
+
+struct output_sink *const output_sinks[] = {
+	&usb_sink,
+#ifdef CONFIG_APP_SINK_UART
+	&uart_sink,
+#endif
+#ifdef CONFIG_APP_SINK_DIAG
+	&diag_sink,
+#endif
+#ifdef CONFIG_APP_TARGETS
+	&targets_sink,
+#endif
+#ifdef CONFIG_APP_FLASH_LOG
+	&flash_log_sink,
+#endif
+};
+
+const size_t output_num_sinks = ARRAY_SIZE(output_sinks);
+
+int sinks_init(void)
+{
+	nmea_encoder_init(&usb_ctx.nmea);
+
+#ifdef CONFIG_APP_HOST_PULL
+	output_sink_set_idle(&usb_sink, backlog_drain);
+#endif
+
+#ifdef CONFIG_APP_FLASH_LOG
+	output_sink_set_idle(&flash_log_sink, flash_log_sink_idle);
+
+	if (flash_log_init() < 0) {
+		LOG_ERR("Failed to mount the frame log");
+	}
+#endif
+
+#ifdef CONFIG_APP_SINK_UART
+	const struct device *dev =
+		device_get_binding(CONFIG_APP_SINK_UART_PORT);
+	struct uart_config cfg;
+
+	nmea_encoder_init(&uart_ctx.nmea);
+	/* Chart plotters generally do not understand tag blocks. */
+	uart_ctx.nmea.tag_block = false;
+
+	if (!dev) {
+		return -ENODEV;
+	}
+
+	int ret = uart_config_get(dev, &cfg);
+	if (ret < 0) {
+		return ret;
+	}
+
+	cfg.baudrate = CONFIG_APP_SINK_UART_BAUDRATE;
+	ret = uart_configure(dev, &cfg);
+	if (ret < 0) {
+		LOG_ERR("Failed to configure %s: %d", CONFIG_APP_SINK_UART_PORT,
+			ret);
+		return ret;
+	}
+#endif
+
+	return 0;
+}
+
+#if defined(CONFIG_APP_HOST_PULL) && defined(CONFIG_SHELL)
+static int cmd_backlog(const struct shell *shell, size_t argc, char **argv)
+{
+	shell_print(shell, "host: %s", backlog_ready(false) ?
+		    "present" : "absent");
+	shell_print(shell, "backlog: %u/%u bytes",
+		    ring_buf_capacity_get(&backlog) -
+		    ring_buf_space_get(&backlog),
+		    ring_buf_capacity_get(&backlog));
+	shell_print(shell, "stored: %u, dropped: %u, drained: %u",
+		    backlog_stored, backlog_dropped, backlog_drained);
+
+	return 0;
+}
+
+SHELL_CMD_REGISTER(backlog, NULL, "Show host pull backlog statistics",
+		   cmd_backlog);
+#endif
@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef APPLICATION_SRC_SINKS_H_
+#define APPLICATION_SRC_SINKS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Prepare the output sinks, must be called after streams_init(). */
+int sinks_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <drivers/uart.h>
+#include <sys/ring_buffer.h>
+#include <shell/shell.h>
+
+#include "streams.h"
+
+#define LOG_LEVEL CONFIG_LOG_DEFAULT_LEVEL
+#include <logging/log.h>
+LOG_MODULE_REGISTER(streams);
+
+#define MAX_PORTS STREAM_COUNT
+
+struct stream_port {
+	const struct device *dev;
+	struct k_spinlock lock;
+	/** Given by the ISR whenever buffer space is released. */
+	struct k_sem space_sem;
+	/** Set when the host sent anything, cleared by the reader. */
+	atomic_t request;
+	struct ring_buf ring;
+	uint8_t buffer[CONFIG_APP_STREAM_BUFFER_SIZE];
+};
+
+struct stream_stats {
+	uint32_t bytes;
+	uint32_t dropped;
+};
+
+static const char *const stream_names[STREAM_COUNT] = {
+	[STREAM_AIS_A] = "ais-a",
+	[STREAM_AIS_B] = "ais-b",
+	[STREAM_CAPTURE] = "capture",
+	[STREAM_UART] = "uart",
+	[STREAM_LOG] = "log",
+};
+
+static const char *const stream_port_names[STREAM_COUNT] = {
+	[STREAM_AIS_A] = CONFIG_APP_AIS_A_PORT,
+	[STREAM_AIS_B] = CONFIG_APP_AIS_B_PORT,
+#ifdef CONFIG_APP_CAPTURE
+	[STREAM_CAPTURE] = CONFIG_APP_CAPTURE_PORT,
+#endif
+#ifdef CONFIG_APP_SINK_UART
+	[STREAM_UART] = CONFIG_APP_SINK_UART_PORT,
+#endif
+#ifdef CONFIG_APP_FLASH_LOG
+	[STREAM_LOG] = CONFIG_APP_FLASH_LOG_PORT,
+#endif
+};
+
+static struct stream_port ports[MAX_PORTS];
+static struct stream_port *stream_ports[STREAM_COUNT];
+static struct stream_stats stream_stats[STREAM_COUNT];
+
+static void port_isr(const struct device *dev, void *user_data)
+{
+	struct stream_port *port = user_data;
+
+	while (uart_irq_update(dev) && uart_irq_is_pending(dev)) {
+		if (uart_irq_rx_ready(dev)) {
+			uint8_t discard[16];
+
+			/* Output only port, any input counts as a request. */
+			if (uart_fifo_read(dev, discard, sizeof(discard)) > 0) {
+				atomic_set(&port->request, 1);
+			}
+		}
+
+		if (uart_irq_tx_ready(dev)) {
+			uint8_t *data;
+			uint32_t len = ring_buf_get_claim(&port->ring, &data,
+							  sizeof(port->buffer));
+
+			if (len == 0) {
+				uart_irq_tx_disable(dev);
+				continue;
+			}
+
+			int sent = uart_fifo_fill(dev, data, len);
+			ring_buf_get_finish(&port->ring, MAX(sent, 0));
+			k_sem_give(&port->space_sem);
+		}
+	}
+}
+
+static struct stream_port *get_port(const char *name)
+{
+	for (int i = 0; i < ARRAY_SIZE(ports); i++) {
+		struct stream_port *port = &ports[i];
+
+		if (port->dev == NULL) {
+			const struct device *dev = device_get_binding(name);
+			if (!dev) {
+				LOG_ERR("Port %s not found", name);
+				return NULL;
+			}
+
+			port->dev = dev;
+			ring_buf_init(&port->ring, sizeof(port->buffer),
+				      port->buffer);
+			k_sem_init(&port->space_sem, 0, 1);
+			uart_irq_callback_user_data_set(dev, port_isr, port);
+			uart_irq_rx_enable(dev);
+			return port;
+		}
+
+		if (strcmp(port->dev->name, name) == 0) {
+			return port;
+		}
+	}
+
+	return NULL;
+}
+
+int streams_init(void)
+{
+	for (int i = 0; i < STREAM_COUNT; i++) {
+		if (stream_port_names[i] == NULL) {
+			continue;
+		}
+
+		stream_ports[i] = get_port(stream_port_names[i]);
+		if (stream_ports[i] == NULL) {
+			return -ENODEV;
+		}
+
+		LOG_DBG("stream %s on %s", stream_names[i],
+			stream_port_names[i]);
+	}
+
+	return 0;
+}
+
+int stream_write(enum stream_id stream, const void *data, size_t len,
+		 k_timeout_t timeout)
+{
+	struct stream_port *port = stream_ports[stream];
+	struct stream_stats *stats = &stream_stats[stream];
+	k_spinlock_key_t key;
+
+	if (port == NULL) {
+		return -ENODEV;
+	}
+
+	if (len > sizeof(port->buffer)) {
+		return -EINVAL;
+	}
+
+	for (;;) {
+		key = k_spin_lock(&port->lock);
+
+		if (ring_buf_space_get(&port->ring) >= len) {
+			break;
+		}
+
+		k_spin_unlock(&port->lock, key);
+
+		if (K_TIMEOUT_EQ(timeout, K_NO_WAIT) ||
+		    k_sem_take(&port->space_sem, timeout) != 0) {
+			key = k_spin_lock(&port->lock);
+			stats->dropped += len;
+			k_spin_unlock(&port->lock, key);
+			return -EAGAIN;
+		}
+	}
+
+	ring_buf_put(&port->ring, data, len);
+	stats->bytes += len;
+	k_spin_unlock(&port->lock, key);
+
+	uart_irq_tx_enable(port->dev);
+
+	return len;
+}
+
+bool stream_host_present(enum stream_id stream)
+{
+	struct stream_port *port = stream_ports[stream];
+
+	if (port == NULL) {
+		return false;
+	}
+
+#ifdef CONFIG_UART_LINE_CTRL
+	uint32_t dtr;
+
+	/* Ports without modem control lines are always read. */
+	if (uart_line_ctrl_get(port->dev, UART_LINE_CTRL_DTR, &dtr) == 0) {
+		return dtr != 0;
+	}
+#endif
+
+	return true;
+}
+
+bool stream_take_request(enum stream_id stream)
+{
+	struct stream_port *port = stream_ports[stream];
+
+	return port != NULL && atomic_set(&port->request, 0) != 0;
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_streams(const struct shell *shell, size_t argc, char **argv)
+{
+	for (int i = 0; i < STREAM_COUNT; i++) {
+		struct stream_port *port = stream_ports[i];
+
+		if (port == NULL) {
+			continue;
+		}
+
+		shell_print(shell, "%-8s %-10s bytes: %u, dropped: %u",
+			    stream_names[i], port->dev->name,
+			    stream_stats[i].bytes, stream_stats[i].dropped);
+	}
+
+	return 0;
+}
+
+SHELL_CMD_REGISTER(streams, NULL, "Show output stream statistics",
+		   cmd_streams);
+#endif
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef APPLICATION_SRC_STREAMS_H_
+#define APPLICATION_SRC_STREAMS_H_
+
+#include <kernel.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Output streams of the receiver.
+ *
+ * Every stream is mapped to a port by name in Kconfig. Streams mapped to
+ * the same port share its transmit buffer, streams on different ports are
+ * fully independent: a port nobody reads fills up and drops data without
+ * affecting the other ports.
+ */
+enum stream_id {
+	/** Decoded messages from AIS 1. */
+	STREAM_AIS_A,
+	/** Decoded messages from AIS 2. */
+	STREAM_AIS_B,
+	/** Raw bitstream capture. */
+	STREAM_CAPTURE,
+	/** NMEA output to a UART, for example a chart plotter. */
+	STREAM_UART,
+	/** Flash log dump. */
+	STREAM_LOG,
+	STREAM_COUNT,
+};
+
+int streams_init(void);
+
+/**
+ * Queue data for transmission on a stream.
+ *
+ * Writes are all or nothing: when there is not enough space in the port
+ * buffer the caller waits up to the timeout for the port to drain, then the
+ * data is dropped and counted.
+ *
+ * @return Number of bytes queued or negative error code.
+ */
+int stream_write(enum stream_id stream, const void *data, size_t len,
+		 k_timeout_t timeout);
+
+/**
+ * Check whether a host is reading a stream.
+ *
+ * A host has the port open when it asserts DTR. Ports that do not report
+ * DTR are assumed to be read.
+ */
+bool stream_host_present(enum stream_id stream);
+
+/**
+ * Check and clear the request flag of a stream. The flag is set when the
+ * host writes anything to the port.
+ */
+bool stream_take_request(enum stream_id stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
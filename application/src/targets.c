@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <sys/base64.h>
+#include <sys/byteorder.h>
+#include <sys/crc.h>
+#include <shell/shell.h>
+#include <ais_msg.h>
+
+#include "output.h"
+#include "targets.h"
+
+#define TABLE_SIZE CONFIG_APP_TARGETS_SIZE
+#define TABLE_MASK (TABLE_SIZE - 1)
+#define MAX_PROBES 8
+#define MAX_AGE_MS (CONFIG_APP_TARGETS_MAX_AGE * MSEC_PER_SEC)
+
+BUILD_ASSERT((TABLE_SIZE & TABLE_MASK) == 0,
+	     "Target table size must be a power of two");
+
+#define SNAPSHOT_HEADER_SIZE 8
+#define SNAPSHOT_ENTRY_SIZE 24
+#define SNAPSHOT_MAX_SIZE \
+	(SNAPSHOT_HEADER_SIZE + TABLE_SIZE * SNAPSHOT_ENTRY_SIZE + 2)
+/* 48 bytes give one 64 character line of base64. */
+#define SNAPSHOT_LINE_BYTES 48
+
+struct target {
+	/** Zero for unused entries, MMSI 0 is not valid. */
+	uint32_t mmsi;
+	uint32_t seen_ms;
+	int32_t lon;
+	int32_t lat;
+	uint16_t speed;
+	uint16_t course;
+	uint16_t heading;
+	uint8_t type;
+	uint8_t channel;
+};
+
+static struct target table[TABLE_SIZE];
+static K_MUTEX_DEFINE(lock);
+static uint32_t updates;
+static uint32_t evictions;
+
+static inline uint32_t hash(uint32_t mmsi)
+{
+	/* MMSIs share prefixes (country codes), mix all bits. */
+	return (mmsi * 2654435761U) >> 16;
+}
+
+static inline bool expired(const struct target *t, uint32_t now)
+{
+	return t->mmsi == 0 || now - t->seen_ms >= MAX_AGE_MS;
+}
+
+static struct target *lookup(uint32_t mmsi, uint32_t now)
+{
+	uint32_t idx = hash(mmsi);
+	struct target *free_entry = NULL;
+	struct target *oldest = NULL;
+
+	for (int i = 0; i < MAX_PROBES; i++) {
+		struct target *t = &table[(idx + i) & TABLE_MASK];
+
+		if (t->mmsi == mmsi) {
+			if (!expired(t, now)) {
+				return t;
+			}
+
+			/* Nothing of an expired entry is kept. */
+			free_entry = t;
+			break;
+		}
+
+		if (expired(t, now)) {
+			if (free_entry == NULL) {
+				free_entry = t;
+			}
+		} else if (oldest == NULL ||
+			   now - t->seen_ms > now - oldest->seen_ms) {
+			oldest = t;
+		}
+	}
+
+	if (free_entry == NULL) {
+		free_entry = oldest;
+		evictions++;
+	}
+
+	*free_entry = (struct target) {
+		.mmsi = mmsi,
+		.lon = AIS_LON_NOT_AVAILABLE,
+		.lat = AIS_LAT_NOT_AVAILABLE,
+		.speed = AIS_SPEED_NOT_AVAILABLE,
+		.course = AIS_COURSE_NOT_AVAILABLE,
+		.heading = AIS_HEADING_NOT_AVAILABLE,
+	};
+
+	return free_entry;
+}
+
+static void update_position(struct target *t, const struct ais_msg *msg)
+{
+	const struct ais_position *pos = ais_msg_position(msg);
+
+	if (pos != NULL) {
+		t->lon = pos->lon;
+		t->lat = pos->lat;
+		t->speed = pos->speed;
+		t->course = pos->course;
+		t->heading = pos->heading;
+	} else if (msg->type == 4 || msg->type == 11) {
+		t->lon = msg->base_station.lon;
+		t->lat = msg->base_station.lat;
+	} else if (msg->type == 21) {
+		t->lon = msg->aton.lon;
+		t->lat = msg->aton.lat;
+	}
+}
+
+void targets_update(const struct ais_frame *frame)
+{
+	uint8_t buf[OUTPUT_MAX_PAYLOAD + AIS_MSG_BUFFER_PADDING] = { 0 };
+	uint32_t now = frame->time_us / USEC_PER_MSEC;
+	size_t len = MIN(frame->len, OUTPUT_MAX_PAYLOAD);
+	struct ais_msg msg;
+
+	/* The parser reads past the end of the payload. */
+	memcpy(buf, frame->data, len);
+
+	if (ais_msg_parse(buf, len, &msg) < 0 || msg.mmsi == 0) {
+		return;
+	}
+
+	k_mutex_lock(&lock, K_FOREVER);
+
+	struct target *t = lookup(msg.mmsi, now);
+
+	t->seen_ms = now;
+	t->type = msg.type;
+	t->channel = frame->channel;
+	update_position(t, &msg);
+	updates++;
+
+	k_mutex_unlock(&lock);
+}
+
+#ifdef CONFIG_SHELL
+static uint8_t snapshot[SNAPSHOT_MAX_SIZE];
+
+static size_t take_snapshot(uint32_t now)
+{
+	uint8_t *p = snapshot + SNAPSHOT_HEADER_SIZE;
+	uint16_t count = 0;
+
+	k_mutex_lock(&lock, K_FOREVER);
+
+	for (int i = 0; i < TABLE_SIZE; i++) {
+		const struct target *t = &table[i];
+
+		if (expired(t, now)) {
+			continue;
+		}
+
+		sys_put_le32(t->mmsi, p);
+		sys_put_le32(now - t->seen_ms, p + 4);
+		sys_put_le32(t->lon, p + 8);
+		sys_put_le32(t->lat, p + 12);
+		sys_put_le16(t->speed, p + 16);
+		sys_put_le16(t->course, p + 18);
+		sys_put_le16(t->heading, p + 20);
+		p[22] = t->type;
+		p[23] = t->channel;
+		p += SNAPSHOT_ENTRY_SIZE;
+		count++;
+	}
+
+	k_mutex_unlock(&lock);
+
+	snapshot[0] = TARGETS_SNAPSHOT_VERSION;
+	snapshot[1] = SNAPSHOT_ENTRY_SIZE;
+	sys_put_le16(count, snapshot + 2);
+	sys_put_le32(now, snapshot + 4);
+
+	size_t len = p - snapshot;
+
+	sys_put_le16(crc16_ccitt(0xffff, snapshot, len), p);
+
+	return len + 2;
+}
+
+static int cmd_targets_snapshot(const struct shell *shell, size_t argc,
+				char **argv)
+{
+	size_t len = take_snapshot(k_uptime_get_32());
+	uint8_t line[SNAPSHOT_LINE_BYTES / 3 * 4 + 1];
+
+	for (size_t i = 0; i < len; i += SNAPSHOT_LINE_BYTES) {
+		size_t olen;
+
+		base64_encode(line, sizeof(line), &olen, snapshot + i,
+			      MIN(SNAPSHOT_LINE_BYTES, len - i));
+		shell_print(shell, "%s", (char *)line);
+	}
+
+	return 0;
+}
+
+static int cmd_targets_show(const struct shell *shell, size_t argc,
+			    char **argv)
+{
+	uint32_t now = k_uptime_get_32();
+	unsigned int count = 0;
+
+	k_mutex_lock(&lock, K_FOREVER);
+
+	for (int i = 0; i < TABLE_SIZE; i++) {
+		const struct target *t = &table[i];
+
+		if (expired(t, now)) {
+			continue;
+		}
+
+		shell_print(shell, "%09u %c type %2u age %5u s lat %d lon %d "
+			    "sog %u cog %u hdg %u",
+			    t->mmsi, 'A' + t->channel, t->type,
+			    (now - t->seen_ms) / MSEC_PER_SEC, t->lat, t->lon,
+			    t->speed, t->course, t->heading);
+		count++;
+	}
+
+	k_mutex_unlock(&lock);
+
+	shell_print(shell, "%u/%u targets, %u updates, %u evictions", count,
+		    TABLE_SIZE, updates, evictions);
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_targets,
+	SHELL_CMD(show, NULL, "Print the vessel table", cmd_targets_show),
+	SHELL_CMD(snapshot, NULL, "Dump the vessel table as base64",
+		  cmd_targets_snapshot),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(targets, &sub_targets, "Vessel table", NULL);
+#endif
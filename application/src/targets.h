@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2020 Ievgenii Meshcheriakov.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef APPLICATION_SRC_TARGETS_H_
+#define APPLICATION_SRC_TARGETS_H_
+
+#include "ais_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Version of the snapshot layout below. */
+#define TARGETS_SNAPSHOT_VERSION 1
+
+/**
+ * Update the vessel table with a decoded frame.
+ *
+ * The table has CONFIG_APP_TARGETS_SIZE entries keyed by MMSI. A vessel
+ * not heard for CONFIG_APP_TARGETS_MAX_AGE seconds is dropped, when the
+ * table is full the least recently heard vessel is evicted.
+ *
+ * The "targets snapshot" shell command prints the table as base64 encoded
+ * binary, all fields little endian:
+ *
+ *   u8 version, u8 entry size, u16 count, u32 uptime in ms
+ *   count times:
+ *     u32 mmsi, u32 age in ms, i32 lon, i32 lat (1/10000 min),
+ *     u16 speed (1/10 kn), u16 course (1/10 deg), u16 heading,
+ *     u8 last message type, u8 channel
+ *   u16 CRC-16/CCITT of everything above
+ *
+ * scripts/targets.py decodes the snapshot.
+ */
+void targets_update(const struct ais_frame *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif